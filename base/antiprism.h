@@ -57,16 +57,19 @@
 #include "geometryinfo.h"
 #include "geometryutils.h"
 #include "getopt.h"
+#include "halfedge.h"
 #include "iteration.h"
 #include "mathutils.h"
 #include "normal.h"
 #include "planar.h"
+#include "pointindex.h"
 #include "polygon.h"
 #include "povwriter.h"
 #include "random.h"
 #include "scene.h"
 #include "status.h"
 #include "symmetry.h"
+#include "threads.h"
 #include "tiling.h"
 #include "timer.h"
 #include "trans3d.h"
@@ -31,17 +31,20 @@
 #include "geometryutils.h"
 #include "mathutils.h"
 #include "qhull/qhull_ra.h"
+#include "threads.h"
 #include "utils.h"
 
 #include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <functional>
+#include <limits>
 #include <map>
 #include <string>
 #include <vector>
 
 #define NUM_TO_USE_DELAUNAY 20
+#define NUM_TO_PREFILTER_HULL 1000
 
 using std::map;
 using std::pair;
@@ -51,14 +54,170 @@ using std::vector;
 
 namespace anti {
 
-static void qhull_cleanup(qhT *qh)
+// A qhull context for the calling thread. The memory allocator and the
+// error file are set up once and kept between runs, and only the results
+// of a run are freed
+class QhullContext {
+private:
+  qhT qh_val;
+  FILE *errfile;
+
+public:
+  QhullContext()
+  {
+    errfile = fopen("/dev/null", "w"); // suppress qhull error messages
+    if (!errfile) {
+      errfile = fopen("nul", "w"); // try for windows cross compilation
+      if (!errfile)
+        errfile = stderr; // must be a valid pointer
+    }
+    QHULL_LIB_CHECK
+    qh_zero(&qh_val, errfile);
+  }
+
+  ~QhullContext()
+  {
+    qh_freeqhull(&qh_val, !qh_ALL); // free long memory
+    int curlong, totlong;
+    // free short mem and mem allocator
+    qh_memfreeshort(&qh_val, &curlong, &totlong);
+    if (errfile != stderr)
+      fclose(errfile);
+  }
+
+  qhT *get() { return &qh_val; }
+
+  // the points must not be changed or freed until the run is released
+  int run(int dim, int num_points, coordT *points, const string &qh_args)
+  {
+    boolT ismalloc = False;  // don't free points in qh_freeqhull() or realloc
+    FILE *outfile = nullptr; // suppress output from qh_produce_output()
+    return qh_new_qhull(&qh_val, dim, num_points, points, ismalloc,
+                        (char *)qh_args.c_str(), outfile, errfile);
+  }
+
+  void release() { qh_freeqhull(&qh_val, !qh_ALL); }
+};
+
+static QhullContext &get_qhull_context()
 {
-  qh_freeqhull(qh, !qh_ALL); // free long memory
-  int curlong, totlong;
-  qh_memfreeshort(qh, &curlong, &totlong); // free short mem and mem allocator
+  static thread_local QhullContext context;
+  return context;
 }
 
-static Status make_hull(Geometry &geom, bool append, string qh_args)
+// Find the points that may be on the convex hull, in increasing order.
+// If prefiltering, points strictly inside the hull of the extreme points
+// in the directions of the vertices, edge centres and face centres of a
+// cube are dropped (Akl-Toussaint heuristic), otherwise all are kept
+static vector<int> get_hull_candidates(const vector<Vec3d> &verts,
+                                       QhullContext &context, bool prefilter)
+{
+  const int num_pts = verts.size();
+  vector<int> cands;
+  if (!prefilter || num_pts < NUM_TO_PREFILTER_HULL) {
+    for (int i = 0; i < num_pts; i++)
+      cands.push_back(i);
+    return cands;
+  }
+
+  // one of each opposite pair of directions, with a maximum and minimum
+  vector<Vec3d> dirs;
+  for (int i = -1; i < 2; i++)
+    for (int j = -1; j < 2; j++)
+      for (int k = -1; k < 2; k++)
+        if (i > 0 || (!i && j > 0) || (!i && !j && k > 0))
+          dirs.push_back(Vec3d(i, j, k));
+  const int num_dirs = dirs.size();
+
+  // extreme points in each direction, the lowest index if there is a tie
+  const double inf = std::numeric_limits<double>::infinity();
+  const int num_blks = parallel_blocks(num_pts);
+  vector<vector<int>> blk_exts(num_blks, vector<int>(2 * num_dirs, -1));
+  vector<vector<double>> blk_dists(num_blks, vector<double>(2 * num_dirs));
+  parallel_for(num_pts, [&](int start, int end, int blk) {
+    vector<int> &exts = blk_exts[blk];
+    vector<double> &dists = blk_dists[blk];
+    for (int d = 0; d < num_dirs; d++) {
+      dists[2 * d] = -inf;
+      dists[2 * d + 1] = inf;
+    }
+    for (int i = start; i < end; i++)
+      for (int d = 0; d < num_dirs; d++) {
+        const double dist = vdot(verts[i], dirs[d]);
+        if (dist > dists[2 * d]) {
+          dists[2 * d] = dist;
+          exts[2 * d] = i;
+        }
+        if (dist < dists[2 * d + 1]) {
+          dists[2 * d + 1] = dist;
+          exts[2 * d + 1] = i;
+        }
+      }
+  });
+  vector<int> ext_idxs;
+  for (int e = 0; e < 2 * num_dirs; e++) {
+    const bool is_min = e % 2;
+    int ext = -1;
+    double ext_dist = 0.0;
+    for (int blk = 0; blk < num_blks; blk++)
+      if (blk_exts[blk][e] >= 0 &&
+          (ext < 0 || (is_min ? blk_dists[blk][e] < ext_dist
+                              : blk_dists[blk][e] > ext_dist))) {
+        ext = blk_exts[blk][e];
+        ext_dist = blk_dists[blk][e];
+      }
+    if (ext >= 0)
+      ext_idxs.push_back(ext);
+  }
+  sort(ext_idxs.begin(), ext_idxs.end());
+  ext_idxs.erase(unique(ext_idxs.begin(), ext_idxs.end()), ext_idxs.end());
+
+  // face planes of the hull of the extreme points, if it is 3D
+  const int dim = 3;
+  vector<coordT> ext_points;
+  double max_coord = 0.0;
+  for (int idx : ext_idxs)
+    for (int j = 0; j < dim; j++) {
+      ext_points.push_back(verts[idx][j]);
+      max_coord = std::max(max_coord, fabs(verts[idx][j]));
+    }
+  vector<Vec3d> norms;
+  vector<double> offsets;
+  if ((int)ext_idxs.size() > dim &&
+      !context.run(dim, ext_idxs.size(), ext_points.data(), "qhull ")) {
+    qhT *qh = context.get();
+    facetT *facet;
+    FORALLfacets
+    {
+      norms.push_back(
+          Vec3d(facet->normal[0], facet->normal[1], facet->normal[2]));
+      offsets.push_back(facet->offset);
+    }
+  }
+  context.release();
+
+  // a point that is not clearly inside is kept
+  const double margin = 1e-9 * std::max(max_coord, 1.0);
+  vector<char> keep(num_pts, 1);
+  if (norms.size()) {
+    parallel_for(num_pts, [&](int start, int end, int) {
+      for (int i = start; i < end; i++) {
+        bool inside = true;
+        for (unsigned int f = 0; f < norms.size() && inside; f++)
+          inside = vdot(norms[f], verts[i]) + offsets[f] < -margin;
+        keep[i] = !inside;
+      }
+    });
+  }
+
+  for (int i = 0; i < num_pts; i++)
+    if (keep[i])
+      cands.push_back(i);
+  return cands;
+}
+
+static Status make_hull(Geometry &geom, bool append, string qh_args,
+                        bool prefilter)
 {
   vector<Vec3d> verts = geom.verts();
   Vec3d cent = geom.centroid();
@@ -66,34 +225,26 @@ static Status make_hull(Geometry &geom, bool append, string qh_args)
   map<int, Color> vcols;
   vcols = geom.colors(VERTS).get_properties();
 
+  QhullContext &context = get_qhull_context();
+  qhT *qh = context.get();
+
+  // only the points that may be on the hull are passed to qhull, and
+  // cands maps them back to their vertex index numbers
+  const vector<int> cands = get_hull_candidates(verts, context, prefilter);
+
   const int dim = 3;
-  auto *points = new coordT[verts.size() * dim];
+  auto *points = new coordT[cands.size() * dim];
 
-  for (unsigned i = 0; i < verts.size(); i++)
+  for (unsigned i = 0; i < cands.size(); i++)
     for (int j = 0; j < dim; j++)
-      points[i * dim + j] = verts[i][j];
+      points[i * dim + j] = verts[cands[i]][j];
 
   qh_args.insert(0, "qhull o ");
 
-  boolT ismalloc = False;  // don't free points in qh_freeqhull() or realloc
-  FILE *outfile = nullptr; // suppress output from qh_produce_output()
-  FILE *errfile = fopen("/dev/null", "w"); // suppress qhull error messages
-  if (!errfile) {
-    errfile = fopen("nul", "w"); // try for windows cross compilation
-    if (!errfile)
-      errfile = stderr; // must be a valid pointer
-  }
-
-  qhT qh_val;
-  qhT *qh = &qh_val;
-  QHULL_LIB_CHECK
-  qh_zero(qh, errfile);
-
-  int ret = qh_new_qhull(qh, dim, verts.size(), points, ismalloc,
-                         (char *)qh_args.c_str(), outfile, errfile);
+  int ret = context.run(dim, cands.size(), points, qh_args);
 
   if (ret) {
-    qhull_cleanup(qh);
+    context.release();
     delete[] points;
     return Status::error("error calculating convex hull");
   }
@@ -107,7 +258,7 @@ static Status make_hull(Geometry &geom, bool append, string qh_args)
     int i = 0;
     FORALLvertices
     {
-      size_t idx = (vertex->point - points) / dim;
+      size_t idx = cands[(vertex->point - points) / dim];
       vert_order[idx] = i++;
       int v_idx = geom.add_vert(verts[idx]);
       geom.colors(VERTS).set(v_idx, vcols[idx]);
@@ -124,9 +275,9 @@ static Status make_hull(Geometry &geom, bool append, string qh_args)
     FOREACHsetelement_i_(qh, vertexT, facet->vertices, vid)
     {
       if (!append)
-        face.push_back(vert_order[(vid->point - points) / dim]);
+        face.push_back(vert_order[cands[(vid->point - points) / dim]]);
       else
-        face.push_back((vid->point - points) / dim);
+        face.push_back(cands[(vid->point - points) / dim]);
     }
     if (face.size() > 3) {
       // order the face vertices so joining them sequentially will
@@ -141,9 +292,9 @@ static Status make_hull(Geometry &geom, bool append, string qh_args)
         FOREACHsetelement_i_(qh, vertexT, ridge->vertices, vid)
         {
           if (!append)
-            lns.push_back(vert_order[(vid->point - points) / dim]);
+            lns.push_back(vert_order[cands[(vid->point - points) / dim]]);
           else
-            lns.push_back((vid->point - points) / dim);
+            lns.push_back(cands[(vid->point - points) / dim]);
         }
       }
 
@@ -179,14 +330,14 @@ static Status make_hull(Geometry &geom, bool append, string qh_args)
       reverse(geom.raw_faces()[f_no].begin(), geom.raw_faces()[f_no].end());
   }
 
-  qhull_cleanup(qh);
+  context.release();
   delete[] points;
 
   return (message.empty()) ? Status::ok() : Status::warning(message);
 }
 
 static int dimension_safe_make_hull(Geometry &geom, bool append, string qh_args,
-                                    Status *stat)
+                                    bool prefilter, Status *stat)
 {
   // an empty geom should be the only reason an error can occur
   Status tmp;
@@ -197,7 +348,7 @@ static int dimension_safe_make_hull(Geometry &geom, bool append, string qh_args,
   }
 
   int dimension = 3;
-  if (!(stat2 = make_hull(geom, append, qh_args))) {
+  if (!(stat2 = make_hull(geom, append, qh_args, prefilter))) {
     // if make_hull fails
     // assume point, line, or polygon 3 to limit
 
@@ -247,7 +398,7 @@ static int dimension_safe_make_hull(Geometry &geom, bool append, string qh_args,
       geom.add_vert(point1);
 
       // 2D test for polygon
-      if (!(stat2 = make_hull(geom, append, qh_args))) {
+      if (!(stat2 = make_hull(geom, append, qh_args, prefilter))) {
         // if test fails need to test with another point to verify not 2D
         // remove point 1 and enter point 2 (also second narrowest edge) in the
         // sort list
@@ -261,7 +412,7 @@ static int dimension_safe_make_hull(Geometry &geom, bool append, string qh_args,
         Vec3d point2 = cent + pvec[1];
         geom.add_vert(point2);
 
-        if (!(stat2 = make_hull(geom, append, qh_args))) {
+        if (!(stat2 = make_hull(geom, append, qh_args, prefilter))) {
           // if still error then vertices are on a line. Add a second point
           dimension = 1;
 
@@ -270,7 +421,7 @@ static int dimension_safe_make_hull(Geometry &geom, bool append, string qh_args,
           geom.add_vert(point1);
 
           // 1D test for line
-          if (!(stat2 = make_hull(geom, append, qh_args))) {
+          if (!(stat2 = make_hull(geom, append, qh_args, prefilter))) {
             // 0 dimensional geom should not have gotten in here. instead, make
             // this an error so it can be spotted
             stat2.set_error(
@@ -335,20 +486,20 @@ static int dimension_safe_make_hull(Geometry &geom, bool append, string qh_args,
   return dimension;
 }
 
-Status add_hull(Geometry &geom, string qh_args, int *dim)
+Status add_hull(Geometry &geom, string qh_args, int *dim, bool prefilter)
 {
   Status stat;
-  int ret = dimension_safe_make_hull(geom, true, qh_args, &stat);
+  int ret = dimension_safe_make_hull(geom, true, qh_args, prefilter, &stat);
   if (dim)
     *dim = ret;
 
   return stat;
 }
 
-Status set_hull(Geometry &geom, string qh_args, int *dim)
+Status set_hull(Geometry &geom, string qh_args, int *dim, bool prefilter)
 {
   Status stat;
-  int ret = dimension_safe_make_hull(geom, false, qh_args, &stat);
+  int ret = dimension_safe_make_hull(geom, false, qh_args, prefilter, &stat);
   if (dim)
     *dim = ret;
 
@@ -370,23 +521,10 @@ Status get_delaunay_edges(const vector<Vec3d> &verts,
 
   qh_args.insert(0, "qhull d Qbb QJ o ");
 
-  boolT ismalloc = False;  // don't free points in qh_freeqhull() or realloc
-  FILE *outfile = nullptr; // suppress output from qh_produce_output()
-  FILE *errfile = fopen("/dev/null", "w"); // suppress qhull error messages
-  if (!errfile) {
-    errfile = fopen("nul", "w"); // try for windows cross compilation
-    if (!errfile)
-      errfile = stderr; // must be a valid pointer
-  }
-
-  qhT qh_val;
-  qhT *qh = &qh_val;
-  QHULL_LIB_CHECK
-  qh_zero(qh, errfile);
-
-  if (qh_new_qhull(qh, dim, verts.size(), points, ismalloc,
-                   (char *)qh_args.c_str(), outfile, errfile)) {
-    qhull_cleanup(qh);
+  QhullContext &context = get_qhull_context();
+  qhT *qh = context.get();
+  if (context.run(dim, verts.size(), points, qh_args)) {
+    context.release();
     delete[] points;
     return Status::error("error calculating delaunay triangulation");
   }
@@ -427,7 +565,7 @@ Status get_delaunay_edges(const vector<Vec3d> &verts,
       }
   }
 
-  qhull_cleanup(qh);
+  context.release();
   delete[] points;
 
   return Status::ok();
@@ -478,23 +616,10 @@ Status get_voronoi_cells(const vector<Vec3d> &verts, vector<Geometry> *cells,
 
   qh_args.insert(0, "qhull v o ");
 
-  boolT ismalloc = False;  /* don't free points in qh_freeqhull() or realloc*/
-  FILE *outfile = nullptr; /* output from qh_produce_output()   nullptr ?*/
-  FILE *errfile = fopen("/dev/null", "w"); // suppress qhull error messages
-  if (!errfile) {
-    errfile = fopen("nul", "w"); // try for windows cross compilation
-    if (!errfile)
-      errfile = stderr; // must be a valid pointer
-  }
-
-  qhT qh_val;
-  qhT *qh = &qh_val;
-  QHULL_LIB_CHECK
-  qh_zero(qh, errfile);
-
-  if (qh_new_qhull(qh, dim, verts.size(), points, ismalloc,
-                   (char *)qh_args.c_str(), outfile, errfile)) {
-    qhull_cleanup(qh);
+  QhullContext &context = get_qhull_context();
+  qhT *qh = context.get();
+  if (context.run(dim, verts.size(), points, qh_args)) {
+    context.release();
     delete[] points;
     return Status::error("error calculating voronoi cells");
   }
@@ -573,7 +698,7 @@ Status get_voronoi_cells(const vector<Vec3d> &verts, vector<Geometry> *cells,
   }
   qh_settempfree(qh, &vertices);
 
-  qhull_cleanup(qh);
+  context.release();
   delete[] points;
 
   for (unsigned int i = 0; i < vcells.faces().size(); i++) {
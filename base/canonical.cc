@@ -30,6 +30,7 @@
 
 #include "boundbox.h"
 #include "geometryinfo.h"
+#include "threads.h"
 #include "utils.h"
 
 using std::string;
@@ -152,15 +153,17 @@ Status make_planar_unit(Geometry &base_geom, IterationControl it_ctrl,
 
     if (using_symmetry) {
       // Ensure that the vertices used in adjustment are up to date
-      for (auto v_idx : verts_to_update)
-        sym_updater.update_from_principal_vertex(v_idx);
+      sym_updater.update_from_principal_verts(verts_to_update);
     }
 
     // Initialize face data for just the necessary faces
-    for (auto f_idx : faces_to_process) {
-      norms[f_idx] = geom.face_norm(f_idx).unit();
-      cents[f_idx] = geom.face_cent(f_idx);
-    }
+    parallel_for(faces_to_process.size(), [&](int start, int end, int) {
+      for (int i = start; i < end; i++) {
+        const int f_idx = faces_to_process[i];
+        norms[f_idx] = face_norm(verts, faces[f_idx]).unit();
+        cents[f_idx] = anti::centroid(verts, faces[f_idx]);
+      }
+    });
 
     Vec3d centroid = Vec3d::zero;
     if (using_symmetry) {
@@ -176,45 +179,54 @@ Status make_planar_unit(Geometry &base_geom, IterationControl it_ctrl,
       centroid = geom.centroid();
     }
 
-    double max_diff2 = 0.0;
-    for (auto v_idx : principal_verts) {
-      const auto &vfaces = vert_faces[v_idx];
-      const int vf_sz = vfaces.size();
-      // target vertex is centroid of projection of vertex onto planes
-      for (int f0 = 0; f0 < vf_sz; f0++) {
-        int f0_idx = vfaces[f0];
-        offsets[v_idx] +=
-            nearpoint_on_plane(verts[v_idx], cents[f0_idx], norms[f0_idx]);
-      }
-      offsets[v_idx] = (offsets[v_idx] / vf_sz - verts[v_idx]) * factor;
-
-      // adjust for centroid
-      offsets[v_idx] -= centroid;
-
-      // adjust for orthogonality
-      for (int i = 0; i < 2; i++) {
-        auto n = vcross(norms[vfaces[i + 2]], norms[vfaces[i]]).unit();
-        const auto v_ideal = nearpoint_on_plane(verts[v_idx], Vec3d::zero, n);
-        const auto offset = (v_ideal - verts[v_idx]) * factor * orth_mult;
-        offsets[v_idx] += offset;
-      }
+    // Each vertex offset is independent, the maximum change is found for
+    // each block of vertices and then overall
+    vector<double> blk_max_diff2(parallel_blocks(principal_verts.size()), 0.0);
+    parallel_for(principal_verts.size(), [&](int start, int end, int blk) {
+      for (int p_idx = start; p_idx < end; p_idx++) {
+        const int v_idx = principal_verts[p_idx];
+        const auto &vfaces = vert_faces[v_idx];
+        const int vf_sz = vfaces.size();
+        // target vertex is centroid of projection of vertex onto planes
+        for (int f0 = 0; f0 < vf_sz; f0++) {
+          int f0_idx = vfaces[f0];
+          offsets[v_idx] +=
+              nearpoint_on_plane(verts[v_idx], cents[f0_idx], norms[f0_idx]);
+        }
+        offsets[v_idx] = (offsets[v_idx] / vf_sz - verts[v_idx]) * factor;
+
+        // adjust for centroid
+        offsets[v_idx] -= centroid;
+
+        // adjust for orthogonality
+        for (int i = 0; i < 2; i++) {
+          auto n = vcross(norms[vfaces[i + 2]], norms[vfaces[i]]).unit();
+          const auto v_ideal =
+              nearpoint_on_plane(verts[v_idx], Vec3d::zero, n);
+          const auto offset = (v_ideal - verts[v_idx]) * factor * orth_mult;
+          offsets[v_idx] += offset;
+        }
 
-      // adjust for non-overlap
-      const auto &vfig = vert_figs[v_idx];
-      for (int i = 0; i < 4; i++) {
-        if (vtriple(verts[v_idx], verts[vfig[i]], verts[vfig[(i + 1) % 4]]) >
-            0) {
-          auto v_ideal = anti::centroid(
-              {verts[vfig[0]], verts[vfig[1]], verts[vfig[2]], verts[vfig[3]]});
-          offsets[v_idx] += (v_ideal - verts[v_idx]) * overlap_mult;
-          break;
+        // adjust for non-overlap
+        const auto &vfig = vert_figs[v_idx];
+        for (int i = 0; i < 4; i++) {
+          if (vtriple(verts[v_idx], verts[vfig[i]], verts[vfig[(i + 1) % 4]]) >
+              0) {
+            auto v_ideal = anti::centroid({verts[vfig[0]], verts[vfig[1]],
+                                           verts[vfig[2]], verts[vfig[3]]});
+            offsets[v_idx] += (v_ideal - verts[v_idx]) * overlap_mult;
+            break;
+          }
         }
-      }
 
-      auto diff2 = offsets[v_idx].len2();
-      if (diff2 > max_diff2)
-        max_diff2 = diff2;
-    }
+        auto diff2 = offsets[v_idx].len2();
+        if (diff2 > blk_max_diff2[blk])
+          blk_max_diff2[blk] = diff2;
+      }
+    });
+    double max_diff2 = 0.0;
+    for (double blk_diff2 : blk_max_diff2)
+      max_diff2 = std::max(max_diff2, blk_diff2);
 
     // adjust vertices post-loop
     if (using_symmetry) {
@@ -346,64 +358,82 @@ Status make_planar(Geometry &base_geom, IterationControl it_ctrl,
 
     if (using_symmetry) {
       // Ensure that the vertices used in adjustment are up to date
-      for (auto v_idx : verts_to_update)
-        sym_updater.update_from_principal_vertex(v_idx);
+      sym_updater.update_from_principal_verts(verts_to_update);
     }
 
     // Initialize face data for just the necessary faces
-    for (auto f_idx : faces_to_process) {
-      norms[f_idx] = geom.face_norm(f_idx).unit();
-      cents[f_idx] = geom.face_cent(f_idx);
-    }
-
-    int cnt_proj = 0;
-    int cnt_int = 0;
-    double max_diff2 = 0.0;
-    for (auto v_idx : principal_verts) {
-      int intersect_cnt = 0;
-      const auto &vfaces = vert_faces[v_idx];
-      const int vf_sz = vfaces.size();
-      bool good_intersections = (vf_sz >= 3);
-      for (int f0 = 0; f0 < vf_sz - 2 && good_intersections; f0++) {
-        int f0_idx = vfaces[f0];
-        for (int f1 = f0 + 1; f1 < vf_sz - 1 && good_intersections; f1++) {
-          int f1_idx = vfaces[f1];
-          for (int f2 = f1 + 1; f2 < vf_sz && good_intersections; f2++) {
-            int f2_idx = vfaces[f2];
-            Vec3d intersection;
-            good_intersections = three_plane_intersect(
-                cents[f0_idx], norms[f0_idx], cents[f1_idx], norms[f1_idx],
-                cents[f2_idx], norms[f2_idx], intersection, intersect_test_val);
-            offsets[v_idx] += intersection;
-            intersect_cnt++;
+    parallel_for(faces_to_process.size(), [&](int start, int end, int) {
+      for (int i = start; i < end; i++) {
+        const int f_idx = faces_to_process[i];
+        norms[f_idx] = face_norm(verts, faces[f_idx]).unit();
+        cents[f_idx] = anti::centroid(verts, faces[f_idx]);
+      }
+    });
+
+    // Each vertex offset is independent, the maximum change and the counts
+    // are found for each block of vertices and then overall
+    const int num_blks = parallel_blocks(principal_verts.size());
+    vector<double> blk_max_diff2(num_blks, 0.0);
+    vector<int> blk_cnt_proj(num_blks, 0);
+    vector<int> blk_cnt_int(num_blks, 0);
+    parallel_for(principal_verts.size(), [&](int start, int end, int blk) {
+      for (int p_idx = start; p_idx < end; p_idx++) {
+        const int v_idx = principal_verts[p_idx];
+        int intersect_cnt = 0;
+        const auto &vfaces = vert_faces[v_idx];
+        const int vf_sz = vfaces.size();
+        bool good_intersections = (vf_sz >= 3);
+        for (int f0 = 0; f0 < vf_sz - 2 && good_intersections; f0++) {
+          int f0_idx = vfaces[f0];
+          for (int f1 = f0 + 1; f1 < vf_sz - 1 && good_intersections; f1++) {
+            int f1_idx = vfaces[f1];
+            for (int f2 = f1 + 1; f2 < vf_sz && good_intersections; f2++) {
+              int f2_idx = vfaces[f2];
+              Vec3d intersection;
+              good_intersections = three_plane_intersect(
+                  cents[f0_idx], norms[f0_idx], cents[f1_idx], norms[f1_idx],
+                  cents[f2_idx], norms[f2_idx], intersection,
+                  intersect_test_val);
+              offsets[v_idx] += intersection;
+              intersect_cnt++;
+            }
           }
         }
-      }
-
-      if (good_intersections)
-        offsets[v_idx] =
-            (offsets[v_idx] / intersect_cnt - verts[v_idx]) * plane_factor;
 
-      // no good 3 plane intersections OR
-      // moving to much
-      if (!good_intersections ||
-          offsets[v_idx].len2() / last_max_diff2 > diff2_test_val) {
-        // target vertex is centroid of projection of vertex onto planes
-        offsets[v_idx] = Vec3d::zero;
-        for (int f0 = 0; f0 < vf_sz; f0++) {
-          int f0_idx = vfaces[f0];
-          offsets[v_idx] +=
-              nearpoint_on_plane(verts[v_idx], cents[f0_idx], norms[f0_idx]);
+        if (good_intersections)
+          offsets[v_idx] =
+              (offsets[v_idx] / intersect_cnt - verts[v_idx]) * plane_factor;
+
+        // no good 3 plane intersections OR
+        // moving to much
+        if (!good_intersections ||
+            offsets[v_idx].len2() / last_max_diff2 > diff2_test_val) {
+          // target vertex is centroid of projection of vertex onto planes
+          offsets[v_idx] = Vec3d::zero;
+          for (int f0 = 0; f0 < vf_sz; f0++) {
+            int f0_idx = vfaces[f0];
+            offsets[v_idx] +=
+                nearpoint_on_plane(verts[v_idx], cents[f0_idx], norms[f0_idx]);
+          }
+          offsets[v_idx] =
+              (offsets[v_idx] / vf_sz - verts[v_idx]) * plane_factor;
+          blk_cnt_proj[blk]++;
         }
-        offsets[v_idx] = (offsets[v_idx] / vf_sz - verts[v_idx]) * plane_factor;
-        cnt_proj++;
-      }
-      else
-        cnt_int++;
+        else
+          blk_cnt_int[blk]++;
 
-      auto diff2 = offsets[v_idx].len2();
-      if (diff2 > max_diff2)
-        max_diff2 = diff2;
+        auto diff2 = offsets[v_idx].len2();
+        if (diff2 > blk_max_diff2[blk])
+          blk_max_diff2[blk] = diff2;
+      }
+    });
+    int cnt_proj = 0;
+    int cnt_int = 0;
+    double max_diff2 = 0.0;
+    for (int blk = 0; blk < num_blks; blk++) {
+      cnt_proj += blk_cnt_proj[blk];
+      cnt_int += blk_cnt_int[blk];
+      max_diff2 = std::max(max_diff2, blk_max_diff2[blk]);
     }
 
     // adjust vertices post-loop
@@ -713,7 +713,7 @@ Status Coloring::apply_transparency(const int opacity, const int elem)
     }
 
     // check if some element colors are not set
-    if (get_geom()->colors(elem).get_properties().size() < sz) {
+    if (get_geom()->colors(elem).size() < sz) {
       if (!warnings.empty())
         warnings += " and ";
       warnings += "unset " + elem_str;
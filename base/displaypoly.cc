@@ -1226,7 +1226,7 @@ void DisplaySymmetry::pov_geom(FILE *ofile, const Scene &scen, int /*sig_dgts*/)
 // --------------------------------------------------------------
 // Other functions
 
-ViewOpts::ViewOpts(const char *name) : ProgramOpts(name)
+ViewOpts::ViewOpts(const char *name) : ProgramOpts(name, false)
 {
   geom_defs = new DisplayPoly();
   lab_defs = new DisplayNumLabels();
@@ -30,6 +30,7 @@
 #include "geometryinfo.h"
 #include "mathutils.h"
 #include "symmetry.h"
+#include "threads.h"
 #include "utils.h"
 
 #include <algorithm>
@@ -50,42 +51,81 @@ using std::vector;
 namespace anti {
 
 void sym_repeat(Geometry &geom, const Geometry &part, const Transformations &ts,
-                char col_part_elems, Coloring *clrngs)
+                char col_part_elems, Coloring *clrngs, int num_threads)
 {
   Coloring tmp_clrngs[3];
   if (!clrngs)
     clrngs = tmp_clrngs;
 
-  Geometry symmetry_unit = part;
+  // the unit is copied first, as part and geom may be the same
+  Geometry unit = part;
+  if (col_part_elems & ELEM_EDGES)
+    unit.add_missing_impl_edges();
+
+  const vector<Trans3d> trans(ts.begin(), ts.end());
+  const int num_units = trans.size();
+  const int sizes[3] = {(int)unit.verts().size(), (int)unit.edges().size(),
+                        (int)unit.faces().size()};
+  const int unit_sz = sizes[VERTS] + sizes[EDGES] + sizes[FACES] + 1;
+
+  // Write the units directly into the final element lists
+  // references are taken here, as raw access updates the geometry state
   geom.clear_all();
-  Transformations::const_iterator si;
-  int idx = 0;
-  for (si = ts.begin(); si != ts.end(); si++, idx++) {
-    Geometry sym_unit = symmetry_unit;
-    sym_unit.transform(*si);
-    for (int i = 0; i < 3; i++)
-      clrngs[i].set_geom(&sym_unit);
-
-    if (col_part_elems & ELEM_VERTS)
-      clrngs[VERTS].v_one_col(clrngs[0].get_col(idx));
-    if (col_part_elems & ELEM_EDGES) {
-      sym_unit.add_missing_impl_edges();
-      clrngs[1].e_one_col(clrngs[EDGES].get_col(idx));
+  auto &new_verts = geom.raw_verts();
+  auto &new_edges = geom.raw_edges();
+  auto &new_faces = geom.raw_faces();
+  new_verts.resize((size_t)num_units * sizes[VERTS]);
+  new_edges.resize((size_t)num_units * sizes[EDGES]);
+  new_faces.resize((size_t)num_units * sizes[FACES]);
+  parallel_for(
+      num_units,
+      [&](int start, int end, int) {
+        for (int idx = start; idx < end; idx++) {
+          const int v_offset = idx * sizes[VERTS];
+          transform(unit.verts().data(), sizes[VERTS], trans[idx],
+                    new_verts.data() + v_offset);
+          const int elem_types[] = {EDGES, FACES};
+          for (int type : elem_types) {
+            const auto &elems = (type == EDGES) ? unit.edges() : unit.faces();
+            auto &new_elems = (type == EDGES) ? new_edges : new_faces;
+            for (int i = 0; i < sizes[type]; i++) {
+              auto &new_elem = new_elems[(size_t)idx * sizes[type] + i];
+              new_elem = elems[i];
+              for (auto &v_idx : new_elem)
+                v_idx += v_offset;
+            }
+          }
+        }
+      },
+      num_threads, std::max(DEF_PARALLEL_GRAIN / unit_sz, 1));
+
+  // Colour the units, by unit index or with the part colours
+  const char col_flags[3] = {ELEM_VERTS, ELEM_EDGES, ELEM_FACES};
+  for (int type = 0; type < 3; type++) {
+    auto &cols = geom.colors(type);
+    if (col_part_elems & col_flags[type]) {
+      for (int idx = 0; idx < num_units; idx++) {
+        const Color col = clrngs[type].get_col(idx);
+        if (col.is_set())
+          for (int i = 0; i < sizes[type]; i++)
+            cols.set(idx * sizes[type] + i, col);
+      }
+    }
+    else {
+      for (int idx = 0; idx < num_units; idx++)
+        cols.append(unit.colors(type), idx * sizes[type]);
     }
-    if (col_part_elems & ELEM_FACES)
-      clrngs[2].f_one_col(clrngs[FACES].get_col(idx));
-    geom.append(sym_unit);
   }
 }
 
 bool sym_repeat(Geometry &geom, const Geometry &part, const Symmetry &sym,
-                char col_part_elems, Coloring *clrngs)
+                char col_part_elems, Coloring *clrngs, int num_threads)
 {
   Transformations ts;
   sym.get_trans(ts);
   if (!ts.is_set())
     return false;
-  sym_repeat(geom, part, ts, col_part_elems, clrngs);
+  sym_repeat(geom, part, ts, col_part_elems, clrngs, num_threads);
   return true;
 }
 
@@ -108,10 +148,9 @@ int orient_geom(Geometry &geom, vector<vector<int>> *parts)
 {
   int part_num = 0;
   const int done = -1;
-  auto edges = geom.get_edge_face_pairs(false);
+  HalfEdgeMesh hes(geom);
   vector<int> cur_idx(geom.faces().size(), 0);
   vector<int> prev_face(geom.faces().size(), 0);
-  vector<int> e_verts(2);
   vector<int> orig_e_verts(2);
   vector<int> e_faces(2);
   for (unsigned int i = 0; i < geom.faces().size(); i++) {
@@ -136,10 +175,12 @@ int orient_geom(Geometry &geom, vector<vector<int>> *parts)
       orig_e_verts[1] = face[idx];
       cur_idx[cur_fidx] = idx ? idx : done; // set to next idx, or mark done
 
-      e_verts = orig_e_verts;
-      if (e_verts[0] > e_verts[1])
-        swap(e_verts[0], e_verts[1]);
-      e_faces = edges.find(e_verts)->second;
+      // the first two faces on the edge, -1 if there is only one
+      const int first =
+          hes.edge_half_edge(hes.find_edge(orig_e_verts[0], orig_e_verts[1]));
+      e_faces[0] = hes.face(first);
+      e_faces[1] = (hes.radial(first) != first) ? hes.face(hes.radial(first))
+                                                : -1;
 
       int next_face = (e_faces[0] != cur_fidx) ? e_faces[0] : e_faces[1];
       if (next_face >= 0 && cur_idx[next_face] == 0) { // face not looked at yet
@@ -31,14 +31,48 @@
 
 #include "color.h"
 
+#include <algorithm>
+#include <climits>
 #include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 namespace anti {
 
 template <class T> class ElemProps {
 private:
-  // Element index to element propert mapping
-  std::map<int, T> ElemProps;
+  // Element index to element property mapping. Used for storage when the
+  // properties are sparse, and otherwise built from the dense storage when
+  // the map is requested
+  mutable std::map<int, T> props_map;
+
+  // Dense storage, used when most index numbers up to the highest have a
+  // property, with a presence bitmap for the properties that are set
+  std::vector<T> dense_props;
+  std::vector<bool> dense_set;
+  int dense_cnt = 0;             // number of properties in dense storage
+  bool dense = false;            // properties are held in dense storage
+  mutable bool map_valid = true; // props_map holds all the properties
+
+  // Check for conversion to dense storage at this map size
+  size_t next_dense_check = dense_min_size;
+  static const size_t dense_min_size = 32;
+
+  // Serialises building props_map from the dense storage in const calls
+  static std::mutex &map_mutex()
+  {
+    static std::mutex mtx;
+    return mtx;
+  }
+
+  static bool is_dense_enough(size_t num, int max_idx)
+  {
+    return num >= dense_min_size && (size_t)max_idx < 2 * num;
+  }
+  void map_invalidate();
+  void to_dense();
+  void to_map();
 
 public:
   /// Set an element property.
@@ -55,15 +89,30 @@ public:
    * \return The property. */
   T get(int idx) const;
 
+  /// Get the number of elements with a property.
+  /**\return The number of elements. */
+  size_t size() const;
+
   /// Clear all element properties.
   void clear();
 
+  /// Call a function for each element property, in index number order
+  /** The properties are read from the storage in use, without building
+   *  the properties map.
+   * \param fn the function, called as \c fn(idx, prop). */
+  template <class F> void for_each(F fn) const;
+
   /// Get the properties map
-  /**\return The properties map. */
+  /** If the properties are held in dense storage the map is built from
+   *  them, which is O(n). The map is cleared when a property is next set
+   *  or deleted, so the reference must not be used after that. Use
+   *  for_each() to read the properties without building the map.
+   * \return The properties map. */
   const std::map<int, T> &get_properties() const;
 
   /// Get the properties map
-  /**\return The properties map. */
+  /** The properties are moved into the map, which may then be changed.
+   * \return The properties map. */
   std::map<int, T> &get_properties();
 
   /// Map properties to different index numbers.
@@ -73,6 +122,12 @@ public:
    *           if the new index number is \c -1 then the element index
    *           has been deleted so the property is deleted. */
   void remap(const std::map<int, int> &chg_map);
+
+  /// Add the properties of another element property container.
+  /**\param props the element properties to add.
+   * \param offset value to add to the index numbers of the added
+   *  properties. */
+  void append(const ElemProps &props, int offset);
 };
 
 /// Geometry property container
@@ -106,51 +161,229 @@ public:
 
 // Implementation
 
+template <class T> const size_t ElemProps<T>::dense_min_size;
+
+template <class T> void ElemProps<T>::map_invalidate()
+{
+  if (map_valid) {
+    props_map.clear();
+    map_valid = false;
+  }
+}
+
+template <class T> void ElemProps<T>::to_dense()
+{
+  const int max_idx = props_map.rbegin()->first;
+  dense_props.assign(max_idx + 1, T());
+  dense_set.assign(max_idx + 1, false);
+  for (const auto &kp : props_map) {
+    dense_props[kp.first] = kp.second;
+    dense_set[kp.first] = true;
+  }
+  dense_cnt = props_map.size();
+  dense = true;
+  map_valid = true; // keep the map until a property is changed
+}
+
+template <class T> void ElemProps<T>::to_map()
+{
+  static_cast<const ElemProps &>(*this).get_properties(); // ensure valid
+  std::vector<T>().swap(dense_props);
+  std::vector<bool>().swap(dense_set);
+  dense_cnt = 0;
+  dense = false;
+  next_dense_check = std::max(2 * props_map.size(), dense_min_size);
+}
+
 template <class T> void ElemProps<T>::set(int idx, const T &prop)
 {
-  if (prop.is_set())
-    ElemProps[idx] = prop;
-  else
+  if (!prop.is_set()) {
     del(idx);
+    return;
+  }
+
+  if (dense) {
+    if (idx >= 0 && (size_t)idx < dense_props.size()) {
+      map_invalidate();
+      if (!dense_set[idx]) {
+        dense_set[idx] = true;
+        dense_cnt++;
+      }
+      dense_props[idx] = prop;
+      return;
+    }
+    else if (idx >= 0 && is_dense_enough(dense_cnt + 1, idx)) {
+      map_invalidate();
+      dense_props.resize(idx + 1);
+      dense_set.resize(idx + 1);
+      dense_set[idx] = true;
+      dense_props[idx] = prop;
+      dense_cnt++;
+      return;
+    }
+    to_map();
+  }
+
+  // properties are often set in index order, so try adding at the end
+  if (props_map.empty() || idx > props_map.rbegin()->first)
+    props_map.emplace_hint(props_map.end(), idx, prop);
+  else
+    props_map[idx] = prop;
+
+  if (props_map.size() >= next_dense_check) {
+    next_dense_check = 2 * props_map.size();
+    if (props_map.begin()->first >= 0 &&
+        is_dense_enough(props_map.size(), props_map.rbegin()->first))
+      to_dense();
+  }
 }
 
-template <class T> void ElemProps<T>::del(int idx) { ElemProps.erase(idx); }
+template <class T> void ElemProps<T>::del(int idx)
+{
+  if (dense) {
+    if (idx >= 0 && (size_t)idx < dense_props.size() && dense_set[idx]) {
+      map_invalidate();
+      dense_set[idx] = false;
+      dense_props[idx] = T();
+      dense_cnt--;
+    }
+  }
+  else
+    props_map.erase(idx);
+}
 
 template <class T> T ElemProps<T>::get(int idx) const
 {
-  auto mi = ElemProps.find(idx);
-  if (mi != ElemProps.end())
+  if (dense) {
+    if (idx >= 0 && (size_t)idx < dense_props.size() && dense_set[idx])
+      return dense_props[idx];
+    else
+      return T();
+  }
+
+  auto mi = props_map.find(idx);
+  if (mi != props_map.end())
     return mi->second;
   else
     return T();
 }
 
-template <class T> void ElemProps<T>::clear() { ElemProps.clear(); }
+template <class T> size_t ElemProps<T>::size() const
+{
+  return (dense) ? dense_cnt : props_map.size();
+}
+
+template <class T> void ElemProps<T>::clear()
+{
+  props_map.clear();
+  std::vector<T>().swap(dense_props);
+  std::vector<bool>().swap(dense_set);
+  dense_cnt = 0;
+  dense = false;
+  map_valid = true;
+  next_dense_check = dense_min_size;
+}
+
+template <class T>
+template <class F>
+void ElemProps<T>::for_each(F fn) const
+{
+  if (dense) {
+    for (size_t i = 0; i < dense_props.size(); i++)
+      if (dense_set[i])
+        fn((int)i, dense_props[i]);
+  }
+  else
+    for (const auto &kp : props_map)
+      fn(kp.first, kp.second);
+}
 
 template <class T> const std::map<int, T> &ElemProps<T>::get_properties() const
 {
-  return ElemProps;
+  std::lock_guard<std::mutex> lock(map_mutex());
+  if (!map_valid) {
+    for (size_t i = 0; i < dense_props.size(); i++)
+      if (dense_set[i])
+        props_map.emplace_hint(props_map.end(), i, dense_props[i]);
+    map_valid = true;
+  }
+  return props_map;
 }
 
 template <class T> std::map<int, T> &ElemProps<T>::get_properties()
 {
-  return ElemProps;
+  if (dense)
+    to_map();
+  return props_map;
 }
 
 template <class T> void ElemProps<T>::remap(const std::map<int, int> &chg_map)
 {
   if (!chg_map.size())
     return;
-  std::map<int, T> new_props;
-  for (const auto &kp : chg_map) {
-    if (kp.second != -1) {
-      auto cmi = ElemProps.find(kp.first);
-      if (cmi != ElemProps.end())
-        new_props[kp.second] = cmi->second;
+
+  // Find the properties to keep, walking the old index numbers in order
+  std::vector<std::pair<int, const T *>> new_props;
+  int min_idx = INT_MAX;
+  int max_idx = -1;
+  bool in_order = true;
+  auto add_prop = [&](int idx, const T *prop) {
+    if (!new_props.empty() && idx <= new_props.back().first)
+      in_order = false;
+    new_props.push_back(std::make_pair(idx, prop));
+    min_idx = std::min(min_idx, idx);
+    max_idx = std::max(max_idx, idx);
+  };
+  if (dense) {
+    for (const auto &kp : chg_map)
+      if (kp.second != -1 && kp.first >= 0 &&
+          (size_t)kp.first < dense_props.size() && dense_set[kp.first])
+        add_prop(kp.second, &dense_props[kp.first]);
+  }
+  else {
+    auto mi = props_map.begin();
+    for (const auto &kp : chg_map) {
+      while (mi != props_map.end() && mi->first < kp.first)
+        ++mi;
+      if (mi == props_map.end())
+        break;
+      if (kp.second != -1 && mi->first == kp.first)
+        add_prop(kp.second, &mi->second);
+    }
+  }
+
+  ElemProps<T> remapped;
+  if (min_idx >= 0 && is_dense_enough(new_props.size(), max_idx)) {
+    remapped.dense_props.resize(max_idx + 1);
+    remapped.dense_set.resize(max_idx + 1);
+    for (const auto &np : new_props) {
+      remapped.dense_cnt += !remapped.dense_set[np.first];
+      remapped.dense_props[np.first] = *np.second;
+      remapped.dense_set[np.first] = true;
     }
+    remapped.dense = true;
+    remapped.map_valid = false;
+  }
+  else {
+    if (!in_order)
+      std::stable_sort(new_props.begin(), new_props.end(),
+                       [](const std::pair<int, const T *> &a,
+                          const std::pair<int, const T *> &b) {
+                         return a.first < b.first;
+                       });
+    for (const auto &np : new_props)
+      remapped.props_map[np.first] = *np.second;
+    remapped.next_dense_check =
+        std::max(2 * remapped.props_map.size(), dense_min_size);
   }
 
-  ElemProps = new_props;
+  *this = std::move(remapped);
+}
+
+template <class T>
+void ElemProps<T>::append(const ElemProps &props, int offset)
+{
+  props.for_each([&](int idx, const T &prop) { set(idx + offset, prop); });
 }
 
 template <class T>
@@ -175,11 +408,8 @@ void GeomElemProps<T>::append(const GeomElemProps &geom_props, int v_size,
                               int e_size, int f_size)
 {
   int offs[] = {v_size, e_size, f_size};
-  for (int i = 0; i < 3; i++) {
-    std::map<int, Color>::const_iterator mi;
-    for (const auto &pk : geom_props[i].get_properties())
-      elem_props[i].set(pk.first + offs[i], pk.second);
-  }
+  for (int i = 0; i < 3; i++)
+    elem_props[i].append(geom_props[i], offs[i]);
 }
 
 } // namespace anti
@@ -28,6 +28,7 @@
 
 #include "geometry.h"
 #include "geometryutils.h"
+#include "halfedge.h"
 
 #include <algorithm>
 #include <cstdio>
@@ -48,49 +49,35 @@ namespace anti {
 // close a polyhedron, no more than two open edges per vertex
 bool close_poly_basic(Geometry &geom, const Color &col)
 {
-  map<vector<int>, int> edges;
-  map<vector<int>, int>::iterator mi, mi2;
-  vector<int> edge(2);
-  vector<int> r_edge(2);
-  for (unsigned int i = 0; i < geom.faces().size(); ++i)
-    for (unsigned int j = 0; j < geom.faces(i).size(); ++j) {
-      edge[0] = geom.faces(i, j);
-      edge[1] = geom.faces_mod(i, j + 1);
-      mi = edges.find(edge);
-      if (mi != edges.end())
-        mi->second++;
-      else {
-        r_edge[0] = edge[1];
-        r_edge[1] = edge[0];
-        mi2 = edges.find(r_edge);
-        if (mi2 != edges.end())
-          mi2->second++;
-        else
-          edges[r_edge] = 1; // edge is oriented for missing face
-      }
+  // open edges, oriented for the missing face, in order
+  HalfEdgeMesh hes(geom);
+  vector<pair<int, int>> open_edges;
+  for (int e_idx = 0; e_idx < hes.num_edges(); e_idx++)
+    if (hes.edge_size(e_idx) == 1) {
+      const int he = hes.edge_half_edge(e_idx);
+      open_edges.push_back({hes.vert_to(he), hes.vert(he)});
     }
+  std::sort(open_edges.begin(), open_edges.end());
 
   map<int, vector<int>> neighbours;
   map<int, vector<int>>::iterator ni;
-  for (mi = edges.begin(); mi != edges.end(); mi++) {
-    if (mi->second == 1) {
-      for (int i = 0; i < 2; i++) {
-        const int from = mi->first[i];
-        const int to = mi->first[(i + 1) % 2];
-        ni = neighbours.find(from);
-        if (ni == neighbours.end()) {
-          vector<int> idxs(2, -1);
-          idxs[i] = to;
-          neighbours[from] = idxs;
-        }
-        else {
-          if (ni->second[0] < 0)
-            ni->second[0] = to;
-          else if (ni->second[1] < 0)
-            ni->second[1] = to;
-          else // three open edges at a vertex
-            return false;
-        }
+  for (const auto &edge : open_edges) {
+    for (int i = 0; i < 2; i++) {
+      const int from = (i == 0) ? edge.first : edge.second;
+      const int to = (i == 0) ? edge.second : edge.first;
+      ni = neighbours.find(from);
+      if (ni == neighbours.end()) {
+        vector<int> idxs(2, -1);
+        idxs[i] = to;
+        neighbours[from] = idxs;
+      }
+      else {
+        if (ni->second[0] < 0)
+          ni->second[0] = to;
+        else if (ni->second[1] < 0)
+          ni->second[1] = to;
+        else // three open edges at a vertex
+          return false;
       }
     }
   }
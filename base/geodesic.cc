@@ -221,7 +221,7 @@ void Geodesic::init()
   triangulate_basic(base, false, 0);
   base.add_missing_impl_edges();
   for (unsigned int i = 0; i < base.faces().size(); i++) {
-    min_idx_first(base.faces(i));
+    min_idx_first(base.faces_mut(i));
   }
 
   for (unsigned int i = 0; i < base.edges().size(); i++)
@@ -29,6 +29,7 @@
 #include "geometry.h"
 #include "coloring.h"
 #include "geometryinfo.h"
+#include "halfedge.h"
 #include "private_misc.h"
 #include "private_off_file.h"
 #include "private_std_polys.h"
@@ -63,10 +64,58 @@ int Geometry::add_verts(const vector<Vec3d> &vrts)
   return verts().size() - 1;
 }
 
+// Key for the edge index, independent of the vertex order
+static inline long long edge_key(int v_idx1, int v_idx2)
+{
+  if (v_idx1 > v_idx2)
+    swap(v_idx1, v_idx2);
+  return ((long long)v_idx1 << 32) | (unsigned int)v_idx2;
+}
+
+void Geometry::edge_index_add(int e_idx) const
+{
+  // only the first edge with a particular pair of vertices is indexed
+  edge_idx_map.emplace(edge_key(edges(e_idx, 0), edges(e_idx, 1)), e_idx);
+}
+
+void Geometry::edge_index_update(bool rebuild) const
+{
+  const unsigned long changes = edge_changes.get();
+  if (rebuild || edge_idx_changes != changes ||
+      edge_idx_cnt > edge_elems.size()) {
+    edge_idx_map.clear();
+    edge_idx_cnt = 0;
+    edge_idx_changes = changes;
+  }
+
+  // index any edges added since the last update
+  if (edge_idx_cnt < edge_elems.size()) {
+    edge_idx_map.reserve(edge_elems.size());
+    for (; edge_idx_cnt < edge_elems.size(); edge_idx_cnt++)
+      edge_index_add(edge_idx_cnt);
+  }
+}
+
+int Geometry::find_edge(int v_idx1, int v_idx2) const
+{
+  // const calls may be concurrent, and the index is updated lazily
+  std::lock_guard<std::mutex> lock(edge_idx_mtx.mtx);
+  edge_index_update();
+  const long long key = edge_key(v_idx1, v_idx2);
+  auto mi = edge_idx_map.find(key);
+  if (mi != edge_idx_map.end() &&
+      edge_key(edges(mi->second, 0), edges(mi->second, 1)) != key) {
+    // the edge was changed through a retained reference, so rebuild
+    edge_index_update(true);
+    mi = edge_idx_map.find(key);
+  }
+  return (mi != edge_idx_map.end()) ? mi->second : -1;
+}
+
 int Geometry::add_edge_raw(const vector<int> &edge, Color col)
 {
   int idx = edges().size();
-  raw_edges().push_back(edge);
+  edge_elems.push_back(edge); // indexed when next needed
   if (col.is_set())
     colors(EDGES).set(idx, col);
   return idx;
@@ -84,14 +133,12 @@ int Geometry::add_edge(std::vector<int> edge, Color col)
   int idx;
   if (edge[0] > edge[1])
     swap(edge[0], edge[1]);
-  auto ei = find(edges().begin(), edges().end(), edge);
-  if (ei != edges().end()) {
-    idx = ei - edges().begin();
+  idx = find_edge(edge[0], edge[1]);
+  if (idx >= 0)
     colors(EDGES).set(idx, col);
-  }
   else {
     idx = edges().size();
-    raw_edges().push_back(edge);
+    edge_elems.push_back(edge); // indexed when next needed
     if (col.is_set())
       colors(EDGES).set(idx, col);
   }
@@ -269,7 +316,7 @@ void Geometry::append(const Geometry &geom)
   remap_shift(g_faces, verts().size());
 
   raw_verts().insert(raw_verts().end(), g_verts.begin(), g_verts.end());
-  raw_edges().insert(raw_edges().end(), g_edges.begin(), g_edges.end());
+  edge_elems.insert(edge_elems.end(), g_edges.begin(), g_edges.end());
   raw_faces().insert(raw_faces().end(), g_faces.begin(), g_faces.end());
 }
 
@@ -305,14 +352,14 @@ void Geometry::get_impl_edges(vector<vector<int>> &edgs) const
   edgs.erase(vit, edgs.end());
 }
 
-Status Geometry::add_hull(string qh_args, int *dim)
+Status Geometry::add_hull(string qh_args, int *dim, bool prefilter)
 {
-  return anti::add_hull(*this, qh_args, dim);
+  return anti::add_hull(*this, qh_args, dim, prefilter);
 }
 
-Status Geometry::set_hull(string qh_args, int *dim)
+Status Geometry::set_hull(string qh_args, int *dim, bool prefilter)
 {
-  return anti::set_hull(*this, qh_args, dim);
+  return anti::set_hull(*this, qh_args, dim, prefilter);
 }
 
 int Geometry::orient(vector<vector<int>> *parts)
@@ -353,6 +400,16 @@ void Geometry::write(FILE *file, int sig_dgts) const
   off_file_write(file, *this, sig_dgts);
 }
 
+Status Geometry::write_bin(string file_name) const
+{
+  return off_bin_file_write(file_name, *this);
+}
+
+Status Geometry::write_bin(FILE *file) const
+{
+  return off_bin_file_write(file, *this);
+}
+
 Status Geometry::write_crds(string file_name, const char *sep,
                             int sig_dgts) const
 {
@@ -378,6 +435,36 @@ void Geometry::write_obj(FILE *file, FILE *mfile, string mtl_file,
 
 GeometryInfo Geometry::get_info() const { return GeometryInfo(*this); }
 
+bool Geometry::TopologyKey::operator==(const TopologyKey &other) const
+{
+  return edge_changes == other.edge_changes &&
+         face_changes == other.face_changes && num_verts == other.num_verts &&
+         num_edges == other.num_edges && num_faces == other.num_faces;
+}
+
+Geometry::TopologyKey Geometry::get_topology_key() const
+{
+  TopologyKey key;
+  key.edge_changes = edge_changes.get();
+  key.face_changes = face_changes.get();
+  key.num_verts = verts().size();
+  key.num_edges = edges().size();
+  key.num_faces = faces().size();
+  return key;
+}
+
+std::shared_ptr<GeometryTopology> Geometry::get_topology() const
+{
+  // const calls may be concurrent, so the replacement is serialised
+  std::lock_guard<std::recursive_mutex> lock(GeometryTopology::get_mutex());
+  const TopologyKey key = get_topology_key();
+  if (!topology || !(topology_key == key)) {
+    topology = std::make_shared<GeometryTopology>();
+    topology_key = key;
+  }
+  return topology;
+}
+
 vector<int> make_edge(int v_idx1, int v_idx2)
 {
   vector<int> edge(2);
@@ -390,43 +477,33 @@ vector<int> make_edge(int v_idx1, int v_idx2)
 
 bool Geometry::is_oriented() const
 {
-  std::set<pair<int, int>> edgs;
-  pair<int, int> edge;
-  for (unsigned int f = 0; f < faces().size(); f++)
-    for (unsigned int i = 0; i < faces(f).size(); i++) {
-      edge = pair<int, int>(faces(f, i), faces_mod(f, i + 1));
-      if (edgs.find(edge) != edgs.end())
-        return false;
-      else
-        edgs.insert(edge);
-    }
-  return true;
+  return HalfEdgeMesh(*this).is_oriented();
 }
 
 std::map<std::vector<int>, std::vector<int>>
 Geometry::get_edge_face_pairs(bool oriented) const
 {
   map<vector<int>, vector<int>> edge2facepr;
-  vector<int> vrts(2);
-  for (unsigned int i = 0; i < faces().size(); ++i) {
-    for (unsigned int j = 0; j < faces(i).size(); ++j) {
-      vrts[0] = faces(i, j);
-      vrts[1] = faces_mod(i, j + 1);
-      int face_pos = 0;
-      if (vrts[0] > vrts[1]) {
-        swap(vrts[0], vrts[1]);
-        face_pos = 1;
-      }
-      if (oriented) {
-        if (edge2facepr.find(vrts) == edge2facepr.end()) {
-          edge2facepr[vrts].resize(2);
-          edge2facepr[vrts][(face_pos + 1) % 2] = -1;
-        }
-        edge2facepr[vrts][face_pos] = i;
-      }
-      else
-        edge2facepr[vrts].push_back(i);
+  HalfEdgeMesh hes(*this);
+  // edges are numbered in key order, so each insertion is at the end
+  for (int e_idx = 0; e_idx < hes.num_edges(); e_idx++) {
+    vector<int> vrts = {hes.edge_vert(e_idx, 0), hes.edge_vert(e_idx, 1)};
+    vector<int> &e_faces =
+        edge2facepr.emplace_hint(edge2facepr.end(), vrts, vector<int>())
+            ->second;
+    if (oriented) {
+      // the last face found with each direction, or -1 if none
+      e_faces.assign(2, -1);
+      const int first = hes.edge_half_edge(e_idx);
+      int he = first;
+      do {
+        const int face_pos = (hes.vert(he) != vrts[0]);
+        e_faces[face_pos] = hes.face(he);
+        he = hes.radial(he);
+      } while (he != first);
     }
+    else
+      e_faces = hes.edge_faces(e_idx);
   }
   return edge2facepr;
 }
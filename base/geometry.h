@@ -34,13 +34,18 @@
 #include "trans3d.h"
 #include "vec_utils.h"
 
+#include <atomic>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace anti {
 
 class GeometryInfo;
+class GeometryTopology;
 
 /// Geometry Interface
 class Geometry {
@@ -51,6 +56,66 @@ private:
 
   GeomElemProps<Color> cols;
 
+  // Count of write accesses to an element list. It is copied with the
+  // geometry, and is atomic as write access may be taken by several threads
+  class ChangeCount {
+  private:
+    std::atomic<unsigned long> cnt{0};
+
+  public:
+    ChangeCount() = default;
+    ChangeCount(const ChangeCount &other) : cnt(other.get()) {}
+    ChangeCount &operator=(const ChangeCount &other)
+    {
+      cnt = other.get();
+      return *this;
+    }
+    void bump() { cnt.fetch_add(1, std::memory_order_relaxed); }
+    unsigned long get() const { return cnt.load(std::memory_order_relaxed); }
+  };
+
+  // Mutex for lazily built data, each geometry has its own
+  class LazyMutex {
+  public:
+    std::mutex mtx;
+    LazyMutex() = default;
+    LazyMutex(const LazyMutex &) {}
+    LazyMutex &operator=(const LazyMutex &) { return *this; }
+  };
+
+  ChangeCount edge_changes; // bumped by write access to the edges
+  ChangeCount face_changes; // bumped by write access to the faces
+
+  // Index of the edge list, a normalised vertex pair maps to the index
+  // number of the first edge with those vertices. It is built when first
+  // needed, and rebuilt if the edges have been accessed for writing.
+  mutable std::unordered_map<long long, int> edge_idx_map;
+  mutable unsigned int edge_idx_cnt = 0;       // number of edges indexed
+  mutable unsigned long edge_idx_changes = 0;  // edge_changes when built
+  mutable LazyMutex edge_idx_mtx;              // guards the index
+
+  void edge_index_update(bool rebuild = false) const;
+  void edge_index_add(int e_idx) const;
+
+  // Element state that a topology was found for
+  struct TopologyKey {
+    unsigned long edge_changes = 0;
+    unsigned long face_changes = 0;
+    size_t num_verts = 0;
+    size_t num_edges = 0;
+    size_t num_faces = 0;
+    bool operator==(const TopologyKey &other) const;
+  };
+
+  TopologyKey get_topology_key() const;
+
+  // Topology for the current elements, shared with copies of the geometry.
+  // It is replaced when the key of the current elements differs from the
+  // key it was found for, which catches write access to the faces or
+  // edges, and also elements added through a retained reference.
+  mutable std::shared_ptr<GeometryTopology> topology;
+  mutable TopologyKey topology_key;
+
 public:
   /// Constructor
   Geometry() = default;
@@ -100,7 +165,9 @@ public:
   virtual const std::vector<std::vector<int>> &edges() const;
 
   /// Read/Write access to the edges.
-  /**\return A reference to the edge data. */
+  /** Write access invalidates the edge index used by find_edge(), which
+   *  will be rebuilt the next time it is needed.
+   * \return A reference to the edge data. */
   virtual std::vector<std::vector<int>> &raw_edges();
 
   /// Read access to an edge.
@@ -115,6 +182,19 @@ public:
    */
   virtual int edges(int e_idx, int v_no) const;
 
+  /// Find an edge from vertex index numbers
+  /** The lookup uses a hashed edge index, and takes constant time on
+   *  average. The index is rebuilt after each call of raw_edges(), and
+   *  an indexed edge that no longer has its vertices is detected, but
+   *  other changes made through a retained reference to the edges are
+   *  not seen, so call raw_edges() again after making them. Concurrent
+   *  calls are safe, but not calls concurrent with changes to the edges.
+   * \param v_idx1 index number of first vertex.
+   * \param v_idx2 index number of second vertex.
+   * \return The index number of the edge, or \c -1 if the edge is not
+   *  in the edge list. */
+  int find_edge(int v_idx1, int v_idx2) const;
+
   /// Get the coordinates of a vertex of an edge.
   /**\param e_idx edge index number.
    * \param v_no the position the vertex appears in the edge, \c 0 or \c 1
@@ -138,7 +218,7 @@ public:
   /// Read/Write access to a face.
   /**\param f_idx index number of the face.
    * \return A reference to the face data. */
-  virtual std::vector<int> &faces(int f_idx);
+  virtual std::vector<int> &faces_mut(int f_idx);
 
   /// Get the vertex index number of a face vertex *face vertex in range).
   /**\param f_idx face index number.
@@ -296,10 +376,14 @@ public:
   /**\param qh_args additional arguments to pass to qhull (unsupported,
    *  may not work, check output.)
    * \param dim dimension of the hull 3, 2, 1 or 0.
+   * \param prefilter if \c true, and there are many points, only pass
+   *  the points that may be on the hull to qhull. This is faster when most
+   *  points are inside, but the hull elements may be in a different order.
    * \return status, which evaluates to \c true if qhull could
    *  calculate the hull(possibly with warnings), otherwise \c false
    *  to indicate an error. */
-  Status add_hull(std::string qh_args = "", int *dim = nullptr);
+  Status add_hull(std::string qh_args = "", int *dim = nullptr,
+                  bool prefilter = false);
 
   /// Set the geometry to its convex hull.
   /** If the convex hull could not be calculated the the geometry
@@ -307,10 +391,14 @@ public:
    * \param qh_args additional arguments to pass to qhull (unsupported,
    *  may not work, check output.)
    * \param dim dimension of the hull 3, 2, 1 or 0.
+   * \param prefilter if \c true, and there are many points, only pass
+   *  the points that may be on the hull to qhull. This is faster when most
+   *  points are inside, but the hull elements may be in a different order.
    * \return status, which evaluates to \c true if qhull could
    *  calculate the hull(possibly with warnings), otherwise \c false
    *  to indicate an error. */
-  Status set_hull(std::string qh_args = "", int *dim = nullptr);
+  Status set_hull(std::string qh_args = "", int *dim = nullptr,
+                  bool prefilter = false);
 
   /// Orient the geometry (if possible.)
   /**\param parts used to return the index numbers of the faces
@@ -490,7 +578,8 @@ public:
   //-------------------------------------------
 
   /// Read geometry from a file
-  /** The file is first read as a normal OFF file, if that fails it will be
+  /** A binary OFF file is detected by its signature. Otherwise the file
+   *  is first read as a normal OFF file, if that fails it will be
    *  read as a Qhull formatted OFF file, and if that fails the file will be
    *  read for any coordinates (lines that contains three numbers separated
    *  by commas and/or spaces will be taken as a set of coordinates.)
@@ -500,7 +589,8 @@ public:
   virtual Status read(std::string file_name = "");
 
   /// Read geometry from a file stream
-  /** The file is first read as a normal OFF file, if that fails it will be
+  /** A binary OFF file is detected by its signature. Otherwise the file
+   *  is first read as a normal OFF file, if that fails it will be
    *  read as a Qhull formatted OFF file, and if that fails the file will be
    *  read for any coordinates (lines that contains three numbers separated
    *  by commas and/or spaces will be taken as a set of coordinates.)
@@ -531,6 +621,20 @@ public:
    *  or if negative then the number of digits after the decimal point. */
   virtual void write(FILE *file, int sig_dgts = DEF_SIG_DGTS) const;
 
+  /// Write geometry to a file in binary OFF format
+  /** Coordinates are written at full precision.
+   * \param file_name the file name ("" for standard output.)
+   * \return status, which evaluates to \c true if the file could be written
+   *  (possibly with warnings), otherwise \c false to indicate an error. */
+  virtual Status write_bin(std::string file_name = "") const;
+
+  /// Write geometry to a file stream in binary OFF format
+  /** Coordinates are written at full precision.
+   * \param file the file stream.
+   * \return status, which evaluates to \c true if the data could be
+   *  written, otherwise \c false to indicate an error. */
+  virtual Status write_bin(FILE *file) const;
+
   /// Write coordinates to a file
   /**\param file_name the file name ("" for standard output.)
    * \param sep a string to use as the seperator between coordinates.
@@ -580,6 +684,17 @@ public:
   /**\return GeometryInfo object associated with this geometry. */
   GeometryInfo get_info() const;
 
+  /// Get the topology of the geometry
+  /** The topology holds connectivity information that does not depend on
+   *  the vertex coordinates. It is kept by the geometry, and shared with
+   *  its copies, until there is write access to the faces or edges, or
+   *  the number of vertices, edges or faces changes, so repeated
+   *  GeometryInfo analyses of a geometry reuse the same connectivity.
+   *  Changes made later through a retained reference to the faces or
+   *  edges that keep the numbers of elements are not seen.
+   * \return The topology. */
+  std::shared_ptr<GeometryTopology> get_topology() const;
+
   /// Get implicit edges
   /** Returns the edges of the polygon faces
    * \param edgs the edges are returned here */
@@ -762,6 +877,7 @@ inline Vec3d &Geometry::verts(int v_idx) { return vert_elems[v_idx]; }
 
 inline std::vector<std::vector<int>> &Geometry::raw_edges()
 {
+  edge_changes.bump();
   return edge_elems;
 }
 
@@ -782,6 +898,7 @@ inline int Geometry::edges(int e_idx, int v_no) const
 
 inline std::vector<std::vector<int>> &Geometry::raw_faces()
 {
+  face_changes.bump();
   return face_elems;
 }
 
@@ -795,8 +912,9 @@ inline const std::vector<int> &Geometry::faces(int f_idx) const
   return face_elems[f_idx];
 }
 
-inline std::vector<int> &Geometry::faces(int f_idx)
+inline std::vector<int> &Geometry::faces_mut(int f_idx)
 {
+  face_changes.bump();
   return face_elems[f_idx];
 }
 
@@ -805,6 +923,7 @@ inline int Geometry::faces(int f_idx, int v_no) const
   return face_elems[f_idx][v_no];
 }
 
+
 inline const ElemProps<Color> &Geometry::colors(int type) const
 {
   return cols[type];
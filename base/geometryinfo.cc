@@ -104,6 +104,213 @@ void ElementLimits::init()
 
 bool ElementLimits::is_set() const { return idx[0] != -1; }
 
+//---------------------------------------------------------------------
+// GeometryTopology
+
+std::recursive_mutex &GeometryTopology::get_mutex()
+{
+  static std::recursive_mutex mtx;
+  return mtx;
+}
+
+void GeometryTopology::find_vert_cons(const Geometry &geom)
+{
+  vert_cons.resize(geom.verts().size(), vector<int>());
+  vector<vector<int>> es = geom.edges();
+  geom.get_impl_edges(es);
+  for (auto &e : es) {
+    vert_cons[e[0]].push_back(e[1]);
+    vert_cons[e[1]].push_back(e[0]);
+  }
+}
+
+static void find_vert_elems(const vector<vector<int>> &elems, int num_verts,
+                            vector<vector<int>> &vert_elems)
+{
+  vert_elems.resize(num_verts, vector<int>());
+  for (size_t elem_idx = 0; elem_idx < elems.size(); elem_idx++)
+    for (int v_idx : elems[elem_idx])
+      vert_elems[v_idx].push_back(elem_idx);
+
+  for (auto v_idxs : vert_elems) {
+    sort(v_idxs.begin(), v_idxs.end());
+    v_idxs.erase(unique(v_idxs.begin(), v_idxs.end()), v_idxs.end());
+  }
+}
+
+void GeometryTopology::find_face_cons(const Geometry &geom)
+{
+  const HalfEdgeMesh &hes = get_half_edges(geom);
+  face_cons.resize(geom.faces().size(), vector<vector<int>>());
+  for (unsigned int f_idx = 0; f_idx < geom.faces().size(); f_idx++) {
+    face_cons[f_idx].resize(geom.faces(f_idx).size());
+    for (unsigned int v = 0; v < geom.faces(f_idx).size(); v++) {
+      // faces on the edge in half-edge order
+      const int e_idx = hes.edge(hes.face_half_edge(f_idx, v));
+      const int first = hes.edge_half_edge(e_idx);
+      int he = first;
+      do {
+        if (hes.face(he) != (int)f_idx)
+          face_cons[f_idx][v].push_back(hes.face(he));
+        he = hes.radial(he);
+      } while (he != first);
+    }
+  }
+}
+
+void GeometryTopology::find_vert_figs(const Geometry &geom)
+{
+  const HalfEdgeMesh &hes = get_half_edges(geom);
+  vert_figs.resize(geom.verts().size());
+
+  // find the corners (half-edges starting at the vertex) of each vertex,
+  // in face order
+  const int v_sz = geom.verts().size();
+  vector<vector<int>> v_corners(v_sz);
+  for (int he = 0; he < hes.num_half_edges(); he++)
+    v_corners[hes.vert(he)].push_back(he);
+
+  // copy of vertices to be used for creating the sets of triangles
+  Geometry g_fig;
+  g_fig.raw_verts() = geom.verts();
+  map<vector<int>, int> circuit_edge_cnts;
+
+  for (int i = 0; i < v_sz; i++) {
+    g_fig.clear(FACES);
+    circuit_edge_cnts.clear();
+    bool figure_good = true;
+    for (int he : v_corners[i]) {
+      const int prev = hes.prev(he);
+      if (hes.edge_size(hes.edge(prev)) != 2 ||
+          hes.edge_size(hes.edge(he)) != 2) {
+        figure_good = false;
+        break; // finish processing this vertex
+      }
+      vector<int> tri = {hes.vert(prev), i, hes.vert_to(he)};
+      circuit_edge_cnts[make_edge(tri[2], tri[0])]++;
+      g_fig.add_face(tri);
+    }
+    if (figure_good) {
+      unsigned int num_tris = g_fig.faces().size();
+      close_poly_basic(g_fig);
+      for (unsigned int f_idx = num_tris; f_idx < g_fig.faces().size(); f_idx++)
+        vert_figs[i].push_back(g_fig.faces(f_idx));
+      map<vector<int>, int>::const_iterator ei;
+      for (ei = circuit_edge_cnts.begin(); ei != circuit_edge_cnts.end(); ++ei)
+        if (ei->second == 2) // closed edge must be digonal figure
+          vert_figs[i].push_back(ei->first);
+    }
+  }
+}
+
+void GeometryTopology::find_free_verts(const Geometry &geom)
+{
+  free_verts.clear();
+  vector<int> cnt(geom.verts().size());
+  for (unsigned int i = 0; i < geom.faces().size(); i++)
+    for (unsigned int j = 0; j < geom.faces(i).size(); j++)
+      cnt[geom.faces(i, j)]++;
+  for (unsigned int i = 0; i < geom.edges().size(); i++)
+    for (unsigned int j = 0; j < geom.edges(i).size(); j++)
+      cnt[geom.edges(i, j)]++;
+
+  for (int i = 0; i < (int)cnt.size(); i++)
+    if (cnt[i] == 0)
+      free_verts.push_back(i);
+
+  found_free_verts = true;
+}
+
+bool GeometryTopology::is_oriented(const Geometry &geom)
+{
+  std::lock_guard<std::recursive_mutex> lock(mtx);
+  if (oriented < 0)
+    oriented = geom.is_oriented();
+  return oriented;
+}
+
+const vector<vector<int>> &
+GeometryTopology::get_impl_edges(const Geometry &geom)
+{
+  std::lock_guard<std::recursive_mutex> lock(mtx);
+  if (!impl_edges.size())
+    geom.get_impl_edges(impl_edges);
+  return impl_edges;
+}
+
+const HalfEdgeMesh &GeometryTopology::get_half_edges(const Geometry &geom)
+{
+  std::lock_guard<std::recursive_mutex> lock(mtx);
+  if (!found_half_edges) {
+    half_edges.init(geom);
+    found_half_edges = true;
+  }
+  return half_edges;
+}
+
+const map<vector<int>, vector<int>> &
+GeometryTopology::get_edge_face_pairs(const Geometry &geom, bool oriented)
+{
+  std::lock_guard<std::recursive_mutex> lock(mtx);
+  auto &pairs = efpairs[oriented];
+  if (!pairs.size())
+    pairs = geom.get_edge_face_pairs(oriented);
+  return pairs;
+}
+
+const vector<vector<int>> &GeometryTopology::get_vert_cons(const Geometry &geom)
+{
+  std::lock_guard<std::recursive_mutex> lock(mtx);
+  if (!vert_cons.size())
+    find_vert_cons(geom);
+  return vert_cons;
+}
+
+const vector<vector<int>> &
+GeometryTopology::get_vert_faces(const Geometry &geom)
+{
+  std::lock_guard<std::recursive_mutex> lock(mtx);
+  if (!vert_faces.size())
+    find_vert_elems(geom.faces(), geom.verts().size(), vert_faces);
+  return vert_faces;
+}
+
+const vector<vector<int>> &
+GeometryTopology::get_vert_impl_edges(const Geometry &geom)
+{
+  std::lock_guard<std::recursive_mutex> lock(mtx);
+  if (!vert_impl_edges.size())
+    find_vert_elems(get_impl_edges(geom), geom.verts().size(),
+                    vert_impl_edges);
+  return vert_impl_edges;
+}
+
+const vector<vector<vector<int>>> &
+GeometryTopology::get_face_cons(const Geometry &geom)
+{
+  std::lock_guard<std::recursive_mutex> lock(mtx);
+  if (!face_cons.size())
+    find_face_cons(geom);
+  return face_cons;
+}
+
+const vector<vector<vector<int>>> &
+GeometryTopology::get_vert_figs(const Geometry &geom)
+{
+  std::lock_guard<std::recursive_mutex> lock(mtx);
+  if (!vert_figs.size())
+    find_vert_figs(geom);
+  return vert_figs;
+}
+
+const vector<int> &GeometryTopology::get_free_verts(const Geometry &geom)
+{
+  std::lock_guard<std::recursive_mutex> lock(mtx);
+  if (!found_free_verts)
+    find_free_verts(geom);
+  return free_verts;
+}
+
 //---------------------------------------------------------------------
 // GeometryInfo
 
@@ -113,15 +320,21 @@ GeometryInfo::GeometryInfo(const Geometry &geo, Vec3d center)
   reset();
 }
 
+GeometryTopology &GeometryInfo::get_topo()
+{
+  if (!topo)
+    topo = geom.get_topology();
+  return *topo;
+}
+
 void GeometryInfo::reset()
 {
-  oriented = -1;
+  topo.reset(); // found from the geometry when first needed
   orientable = -1;
   found_connectivity = false;
   genus_val = std::numeric_limits<int>::max();
   dual.clear_all();
   sym = Symmetry();
-  efpairs.clear();
   edge_parts.clear();
   face_angles.clear();
   vert_dihed.clear();
@@ -132,14 +345,8 @@ void GeometryInfo::reset()
   vertex_angles.clear();
   f_areas.clear();
   f_perimeters.clear();
-  vert_impl_edges.clear();
-  vert_faces.clear();
-  vert_cons.clear();
   vert_cons_orig.clear();
-  face_cons.clear();
   vert_norms.clear();
-  found_free_verts = false;
-  free_verts.clear();
   set_center(cent);
 }
 
@@ -156,7 +363,6 @@ const Geometry &GeometryInfo::get_geom() const { return geom; }
 
 Vec3d GeometryInfo::get_center() const { return cent; }
 
-void GeometryInfo::find_impl_edges() { geom.get_impl_edges(impl_edges); }
 
 bool GeometryInfo::is_closed()
 {
@@ -315,37 +521,27 @@ const vector<Vec3d> &GeometryInfo::get_vert_norms(bool local_orient)
 
 const vector<vector<int>> &GeometryInfo::get_vert_cons()
 {
-  if (!vert_cons.size())
-    find_vert_cons();
-  return vert_cons;
+  return get_topo().get_vert_cons(geom);
 }
 
 const vector<vector<int>> &GeometryInfo::get_vert_faces()
 {
-  if (!vert_faces.size())
-    find_vert_elems(geom.faces(), vert_faces);
-  return vert_faces;
+  return get_topo().get_vert_faces(geom);
 }
 
 const vector<vector<int>> &GeometryInfo::get_vert_impl_edges()
 {
-  if (!vert_impl_edges.size())
-    find_vert_elems(get_impl_edges(), vert_impl_edges);
-  return vert_impl_edges;
+  return get_topo().get_vert_impl_edges(geom);
 }
 
 const vector<vector<vector<int>>> &GeometryInfo::get_face_cons()
 {
-  if (!face_cons.size())
-    find_face_cons();
-  return face_cons;
+  return get_topo().get_face_cons(geom);
 }
 
 const vector<vector<vector<int>>> &GeometryInfo::get_vert_figs()
 {
-  if (!vert_figs.size())
-    find_vert_figs();
-  return vert_figs;
+  return get_topo().get_vert_figs(geom);
 }
 
 const vector<double> &GeometryInfo::get_vert_solid_angles()
@@ -372,9 +568,7 @@ const map<pair<int, int>, double> &GeometryInfo::get_plane_angles()
 
 const vector<int> &GeometryInfo::get_free_verts()
 {
-  if (!found_free_verts)
-    find_free_verts();
-  return free_verts;
+  return get_topo().get_free_verts(geom);
 }
 
 // edges
@@ -389,9 +583,12 @@ int GeometryInfo::get_edge_index(int v_idx0, int v_idx1)
 
 const map<vector<int>, vector<int>> &GeometryInfo::get_edge_face_pairs()
 {
-  if (!efpairs.size())
-    find_edge_face_pairs();
-  return efpairs;
+  return get_topo().get_edge_face_pairs(geom, is_oriented());
+}
+
+const HalfEdgeMesh &GeometryInfo::get_half_edges()
+{
+  return get_topo().get_half_edges(geom);
 }
 
 const vector<double> &GeometryInfo::get_edge_dihedrals()
@@ -427,9 +624,7 @@ GeometryInfo::get_edge_lengths_by_size()
 // implicit edges
 const vector<vector<int>> &GeometryInfo::get_impl_edges()
 {
-  if (!impl_edges.size())
-    find_impl_edges();
-  return impl_edges;
+  return get_topo().get_impl_edges(geom);
 }
 
 const map<double, double_range_cnt, AngleLess> &
@@ -520,12 +715,7 @@ Trans3d GeometryInfo::get_symmetry_alignment_to_std()
   return sym.get_to_std();
 }
 
-bool GeometryInfo::is_oriented()
-{
-  if (oriented < 0)
-    oriented = geom.is_oriented();
-  return oriented;
-}
+bool GeometryInfo::is_oriented() { return get_topo().is_oriented(geom); }
 
 bool GeometryInfo::is_orientable()
 {
@@ -537,39 +727,24 @@ bool GeometryInfo::is_orientable()
   return orientable;
 }
 
-void GeometryInfo::find_edge_face_pairs()
-{
-  if (is_oriented())
-    efpairs = geom.get_edge_face_pairs(true);
-  else
-    efpairs = geom.get_edge_face_pairs(false);
-}
-
 void GeometryInfo::find_connectivity()
 {
-  // get a copy of edge face pairs with all faces around an edge
-  map<vector<int>, vector<int>> tmp_efpairs;
-  if (is_oriented())
-    tmp_efpairs = geom.get_edge_face_pairs(false);
-  else if (efpairs.size() == 0)
-    find_edge_face_pairs();
-
-  const map<vector<int>, vector<int>> &pairs =
-      is_oriented() ? tmp_efpairs : efpairs;
+  // all the faces around an edge
+  const HalfEdgeMesh &hes = get_topo().get_half_edges(geom);
 
   known_connectivity = true;
   even_connectivity = true;
   polyhedron = true;
   closed = true;
-  map<vector<int>, vector<int>>::const_iterator ei;
-  for (ei = pairs.begin(); ei != pairs.end(); ++ei) {
-    if (ei->second.size() == 1) // One faces at an edge
+  for (int e_idx = 0; e_idx < hes.num_edges(); e_idx++) {
+    const int num_faces = hes.edge_size(e_idx);
+    if (num_faces == 1) // One faces at an edge
       closed = false;
-    if (ei->second.size() != 2) // Edge not met be exactly 2 faces
+    if (num_faces != 2) // Edge not met be exactly 2 faces
       polyhedron = false;
-    if (ei->second.size() % 2) // Odd number of faces at an edge
+    if (num_faces % 2) // Odd number of faces at an edge
       even_connectivity = false;
-    if (ei->second.size() > 2) // More than two faces at an edge
+    if (num_faces > 2) // More than two faces at an edge
       known_connectivity = false;
   }
 
@@ -685,12 +860,11 @@ void GeometryInfo::find_face_angles()
 
 void GeometryInfo::find_dihedral_angles()
 {
-  if (efpairs.size() == 0)
-    find_edge_face_pairs();
+  const auto &efpairs = get_edge_face_pairs();
   edge_dihedrals.resize(efpairs.size());
 
   dih_angles.init();
-  map<vector<int>, vector<int>>::iterator ei;
+  map<vector<int>, vector<int>>::const_iterator ei;
   map<double, double_range_cnt, AngleLess>::iterator di;
   double cos_a = 1, sign = 1;
   int e_idx = -1;
@@ -827,105 +1001,6 @@ void GeometryInfo::find_vert_cons_orig()
   }
 }
 
-void GeometryInfo::find_vert_cons()
-{
-  vert_cons.resize(num_verts(), vector<int>());
-  vector<vector<int>> es = geom.edges();
-  geom.get_impl_edges(es);
-  for (auto &e : es) {
-    vert_cons[e[0]].push_back(e[1]);
-    vert_cons[e[1]].push_back(e[0]);
-  }
-}
-
-void GeometryInfo::find_vert_elems(const vector<vector<int>> &elems,
-                                   vector<vector<int>> &vert_elems)
-{
-  vert_elems.resize(num_verts(), vector<int>());
-  for (size_t elem_idx = 0; elem_idx < elems.size(); elem_idx++)
-    for (int v_idx : elems[elem_idx])
-      vert_elems[v_idx].push_back(elem_idx);
-
-  for (auto v_idxs : vert_elems) {
-    sort(v_idxs.begin(), v_idxs.end());
-    v_idxs.erase(unique(v_idxs.begin(), v_idxs.end()), v_idxs.end());
-  }
-}
-
-void GeometryInfo::find_face_cons()
-{
-  face_cons.resize(num_faces(), vector<vector<int>>());
-  auto e2fs = geom.get_edge_face_pairs(false);
-  for (unsigned int f_idx = 0; f_idx < geom.faces().size(); f_idx++) {
-    for (unsigned int v = 0; v < geom.faces(f_idx).size(); v++) {
-      face_cons[f_idx].push_back(vector<int>());
-      auto ei = e2fs.find(
-          make_edge(geom.faces(f_idx, v), geom.faces_mod(f_idx, v + 1)));
-      if (ei != e2fs.end()) { // test, but shouldn't fail
-        for (int i : ei->second) {
-          if (i != (int)f_idx)
-            face_cons[f_idx][v].push_back(i);
-        }
-      }
-    }
-  }
-}
-
-void GeometryInfo::find_vert_figs()
-{
-  vert_figs.resize(num_verts());
-  get_vert_cons();
-  auto ef_pairs = geom.get_edge_face_pairs(false);
-
-  // find set of faces that each vertex belongs to
-  const int v_sz = geom.verts().size();
-  vector<set<int>> v_faces(v_sz);
-  for (unsigned int f_idx = 0; f_idx < geom.faces().size(); f_idx++)
-    for (unsigned int v = 0; v < geom.faces(f_idx).size(); v++)
-      v_faces[geom.faces(f_idx, v)].insert(f_idx);
-
-  // copy of vertices to be used for creating the sets of triangles
-  Geometry g_fig;
-  g_fig.raw_verts() = geom.verts();
-  map<vector<int>, int> circuit_edge_cnts;
-
-  for (int i = 0; i < v_sz; i++) {
-    g_fig.clear(FACES);
-    circuit_edge_cnts.clear();
-    bool figure_good = true;
-    for (auto si = v_faces[i].begin(); si != v_faces[i].end(); ++si) {
-      const int f = *si;
-      vector<int> tri(3);
-      for (unsigned int n = 0; n < geom.faces(f).size(); n++) {
-        if (geom.faces(f, n) == i) {
-          tri[0] = geom.faces_mod(f, n - 1);
-          tri[1] = geom.faces(f, n);
-          tri[2] = geom.faces_mod(f, n + 1);
-          if (ef_pairs[make_edge(tri[0], tri[1])].size() != 2 ||
-              ef_pairs[make_edge(tri[1], tri[2])].size() != 2) {
-            figure_good = false;
-            break; // finish processing this face from set
-          }
-          circuit_edge_cnts[make_edge(tri[2], tri[0])]++;
-          g_fig.add_face(tri);
-        }
-      }
-      if (!figure_good)
-        break; // finish processing this vertex
-    }
-    if (figure_good) {
-      unsigned int num_tris = g_fig.faces().size();
-      close_poly_basic(g_fig);
-      for (unsigned int f_idx = num_tris; f_idx < g_fig.faces().size(); f_idx++)
-        vert_figs[i].push_back(g_fig.faces(f_idx));
-      map<vector<int>, int>::const_iterator ei;
-      for (ei = circuit_edge_cnts.begin(); ei != circuit_edge_cnts.end(); ++ei)
-        if (ei->second == 2) // closed edge must be digonal figure
-          vert_figs[i].push_back(ei->first);
-    }
-  }
-}
-
 // Calculate vertex normals as average of surrounding face normals,
 // using existing face orientation (an optimisation when it is known
 // that a model is oriented)
@@ -992,25 +1067,6 @@ void GeometryInfo::find_vert_norms(bool local_orient)
     get_vert_norms_raw_orientation(get_geom(), vert_norms);
 }
 
-void GeometryInfo::find_free_verts()
-{
-  free_verts.clear();
-  const Geometry &geom = get_geom();
-  vector<int> cnt(geom.verts().size());
-  for (unsigned int i = 0; i < geom.faces().size(); i++)
-    for (unsigned int j = 0; j < geom.faces(i).size(); j++)
-      cnt[geom.faces(i, j)]++;
-  for (unsigned int i = 0; i < geom.edges().size(); i++)
-    for (unsigned int j = 0; j < geom.edges(i).size(); j++)
-      cnt[geom.edges(i, j)]++;
-
-  for (int i = 0; i < (int)cnt.size(); i++)
-    if (cnt[i] == 0)
-      free_verts.push_back(i);
-
-  found_free_verts = true;
-}
-
 static double sph_tri_area(Vec3d u0, Vec3d u1, Vec3d u2)
 {
   double sign = 1 - 2 * (vtriple(u0, u1, u2) > 0);
@@ -31,6 +31,12 @@
 
 #include "geometry.h"
 #include "geometryutils.h"
+#include "halfedge.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace anti {
 
@@ -107,6 +113,97 @@ struct double_range_cnt {
   double rad() const { return (max - min) / 2; } // radius of range
 };
 
+/// Topology of a geometry
+/** Connectivity information that depends only on the faces, edges and
+ *  number of vertices of a geometry, and not on the vertex coordinates.
+ *  Each item is found when first requested. A geometry keeps its topology,
+ *  which is shared with copies of the geometry, until its elements change,
+ *  so moving vertices does not discard it (see Geometry::get_topology()).
+ *  The geometry passed to the functions must be the one the topology
+ *  was returned for, or a copy with the same elements. */
+class GeometryTopology {
+private:
+  std::recursive_mutex mtx;
+  int oriented = -1;
+  std::vector<std::vector<int>> impl_edges;
+  HalfEdgeMesh half_edges;
+  bool found_half_edges = false;
+  std::map<std::vector<int>, std::vector<int>> efpairs[2];
+  std::vector<std::vector<int>> vert_cons;
+  std::vector<std::vector<int>> vert_faces;
+  std::vector<std::vector<int>> vert_impl_edges;
+  std::vector<std::vector<std::vector<int>>> face_cons;
+  std::vector<std::vector<std::vector<int>>> vert_figs;
+  std::vector<int> free_verts;
+  bool found_free_verts = false;
+
+  void find_vert_cons(const Geometry &geom);
+  void find_face_cons(const Geometry &geom);
+  void find_vert_figs(const Geometry &geom);
+  void find_free_verts(const Geometry &geom);
+
+public:
+  /// Get the mutex that serialises replacing the topology of a geometry
+  /**\return The mutex. */
+  static std::recursive_mutex &get_mutex();
+
+  /// Check if oriented
+  /**\param geom the geometry.
+   * \return \c true if oriented, otherwise \c false.*/
+  bool is_oriented(const Geometry &geom);
+
+  /// Get implicit edges
+  /**\param geom the geometry.
+   * \return The implicit edges, in sorted order.*/
+  const std::vector<std::vector<int>> &get_impl_edges(const Geometry &geom);
+
+  /// Get half-edge connectivity
+  /**\param geom the geometry.
+   * \return The half-edge connectivity of the faces.*/
+  const HalfEdgeMesh &get_half_edges(const Geometry &geom);
+
+  /// Get edge face pairs
+  /**\param geom the geometry.
+   * \param oriented the form of the face pairs, see
+   *  Geometry::get_edge_face_pairs().
+   * \return A map of the vertex pair of an edge to the faces it lies on.*/
+  const std::map<std::vector<int>, std::vector<int>> &
+  get_edge_face_pairs(const Geometry &geom, bool oriented);
+
+  /// Get vertex connections
+  /**\param geom the geometry.
+   * \return The vertices connected to each vertex.*/
+  const std::vector<std::vector<int>> &get_vert_cons(const Geometry &geom);
+
+  /// Get vertex faces
+  /**\param geom the geometry.
+   * \return The faces connected to each vertex.*/
+  const std::vector<std::vector<int>> &get_vert_faces(const Geometry &geom);
+
+  /// Get vertex implicit edges
+  /**\param geom the geometry.
+   * \return The implicit edges connected to each vertex.*/
+  const std::vector<std::vector<int>> &
+  get_vert_impl_edges(const Geometry &geom);
+
+  /// Get face connections
+  /**\param geom the geometry.
+   * \return The faces connected to each face edge.*/
+  const std::vector<std::vector<std::vector<int>>> &
+  get_face_cons(const Geometry &geom);
+
+  /// Get vertex figures
+  /**\param geom the geometry.
+   * \return The vertex figure circuits for each vertex.*/
+  const std::vector<std::vector<std::vector<int>>> &
+  get_vert_figs(const Geometry &geom);
+
+  /// Get free verts
+  /**\param geom the geometry.
+   * \return The free vertices.*/
+  const std::vector<int> &get_free_verts(const Geometry &geom);
+};
+
 /// Find values and properties of a geometry
 /** The properties and values are cached, including any intermediate values,
  *  (some calculations find several assoociated properties).
@@ -116,7 +213,6 @@ struct double_range_cnt {
 class GeometryInfo {
 private:
   Vec3d cent;
-  int oriented;
   int orientable;
   bool found_connectivity;
   bool closed;
@@ -139,8 +235,6 @@ private:
   ElementLimits ie_dists;
   ElementLimits f_dists;
 
-  std::vector<std::vector<int>> impl_edges;
-  std::map<std::vector<int>, std::vector<int>> efpairs;
   std::vector<std::vector<int>> edge_parts;
   std::map<std::vector<double>, int, AngleVectLess> face_angles;
   std::map<std::vector<double>, int, AngleVectLess> vert_dihed;
@@ -156,34 +250,22 @@ private:
   std::vector<double> f_areas;
   std::vector<double> f_perimeters;
   std::vector<double> f_max_nonplanars;
-  std::vector<std::vector<int>> vert_cons;
   std::vector<std::vector<int>> vert_cons_orig;
-  std::vector<std::vector<int>> vert_faces;
-  std::vector<std::vector<int>> vert_impl_edges;
-  std::vector<std::vector<std::vector<int>>> face_cons;
-  std::vector<std::vector<std::vector<int>>> vert_figs;
   std::vector<Vec3d> vert_norms;
   bool vert_norms_local_orient;
-  std::vector<int> free_verts;
-  bool found_free_verts;
   Geometry dual;
   Symmetry sym;
+  std::shared_ptr<GeometryTopology> topo;
+
+  GeometryTopology &get_topo();
 
-  void find_impl_edges();
   void find_edge_index_numbers();
-  void find_edge_face_pairs();
   void find_edge_parts();
   void find_connectivity();
   void find_face_angles();
   void find_dihedral_angles();
-  void find_vert_cons();
   void find_vert_cons_orig();
-  void find_face_cons();
-  void find_vert_figs();
-  void find_vert_elems(const std::vector<std::vector<int>> &elems,
-                       std::vector<std::vector<int>> &vert_elems);
   void find_vert_norms(bool local_orient = false);
-  void find_free_verts();
   void find_solid_angles();
   void find_e_lengths(std::map<double, double_range_cnt, AngleLess> &e_lens,
                       const std::vector<std::vector<int>> &edges,
@@ -191,7 +273,6 @@ private:
   void find_f_areas();
   void find_f_perimeters();
   void find_f_max_nonplanars();
-  void find_oriented();
   void find_v_dist_lims();
   void find_e_dist_lims();
   void find_ie_dist_lims();
@@ -467,6 +548,10 @@ public:
    * \return A map of the vertex pair of an edge to the faces it lies on.*/
   const std::map<std::vector<int>, std::vector<int>> &get_edge_face_pairs();
 
+  /// Get half-edge connectivity
+  /**\return The half-edge connectivity of the faces.*/
+  const HalfEdgeMesh &get_half_edges();
+
   /// Get the dihedral angle at each edge
   /**\return The dihedral angles.*/
   const std::vector<double> &get_edge_dihedrals();
@@ -32,7 +32,9 @@
 #include "mathutils.h"
 #include "private_geodesic.h"
 #include "private_misc.h"
+#include "threads.h"
 
+#include <algorithm>
 #include <vector>
 
 using std::vector;
@@ -66,58 +68,107 @@ void project_onto_sphere(Geometry &geom, Vec3d centre, double radius)
 
 // RK - test points versus hull functions
 
-bool test_points_vs_hull(const vector<Vec3d> &P, const Geometry &hull,
-                         const bool inside, const bool surface,
-                         const bool outside, const double &eps)
+ConvexContainer::ConvexContainer(const Geometry &hull, double eps)
+    : eps(eps)
 {
   const vector<Vec3d> &verts = hull.verts();
   const vector<vector<int>> &faces = hull.faces();
 
-  Vec3d C = centroid(verts);
-
-  bool answer = true;
+  cent = centroid(verts);
   for (const auto &face : faces) {
     Vec3d n = face_norm(verts, face).unit();
-    double D = vdot(verts[face[0]] - C, n);
+    double D = vdot(verts[face[0]] - cent, n);
     // if(D < 0)
     if (double_compare(D, 0, eps) < 0) { // Make sure the normal points outwards
       D = -D;
       n = -n;
     }
+    norm_x.push_back(n[0]);
+    norm_y.push_back(n[1]);
+    norm_z.push_back(n[2]);
+    offsets.push_back(D);
+  }
+}
 
-    for (const auto &j : P) {
-      double t = vdot(j - C, n);
-      // if (t < D-eps && !inside)
-      if ((double_compare(t, D, eps) < 0) && !inside)
-        answer = false;
-      else
-        // if (t > D+eps && !outside)
-        if ((double_compare(t, D, eps) > 0) && !outside)
-          answer = false;
-        else if (!surface)
-          answer = false;
-
-      if (!answer)
-        break;
+bool ConvexContainer::point_fails(const Vec3d &P, bool inside,
+                                  bool outside) const
+{
+  const Vec3d V = P - cent;
+  const size_t sz = offsets.size();
+  // faces are tested in blocks with no branches, so the inner loop may be
+  // vectorised, and the comparisons are those of double_compare()
+  const size_t blk_sz = 8;
+  for (size_t blk = 0; blk < sz; blk += blk_sz) {
+    const size_t blk_end = std::min(blk + blk_sz, sz);
+    bool below = false;
+    bool above = false;
+    for (size_t i = blk; i < blk_end; i++) {
+      const double diff =
+          V[0] * norm_x[i] + V[1] * norm_y[i] + V[2] * norm_z[i] - offsets[i];
+      below |= (diff < eps) & !(diff > -eps);
+      above |= !(diff < eps);
     }
-
-    if (!answer)
-      break;
+    if ((below && !inside) || (above && !outside))
+      return true;
   }
 
-  return answer;
+  return false;
 }
 
-bool are_points_in_hull(const vector<Vec3d> &points, const Geometry &hull,
-                        unsigned int inclusion_test, const double &eps)
+bool ConvexContainer::includes(const vector<Vec3d> &points,
+                               unsigned int inclusion_test) const
 {
   if (inclusion_test % 8 == 0 ||
       (inclusion_test & INCLUSION_IN && inclusion_test & INCLUSION_OUT))
     return false;
-  else
-    return test_points_vs_hull(points, hull, inclusion_test & INCLUSION_IN,
-                               inclusion_test & INCLUSION_ON,
-                               inclusion_test & INCLUSION_OUT, eps);
+
+  if (points.empty() || offsets.empty())
+    return true;
+  if (!(inclusion_test & INCLUSION_ON))
+    return false; // every point fails at the first face
+
+  for (const auto &P : points)
+    if (point_fails(P, inclusion_test & INCLUSION_IN,
+                    inclusion_test & INCLUSION_OUT))
+      return false;
+
+  return true;
+}
+
+bool ConvexContainer::includes(const Vec3d &P,
+                               unsigned int inclusion_test) const
+{
+  return includes(vector<Vec3d>(1, P), inclusion_test);
+}
+
+void ConvexContainer::find_included(const vector<Vec3d> &points,
+                                    unsigned int inclusion_test,
+                                    vector<char> &included) const
+{
+  included.assign(points.size(), 0);
+  if (inclusion_test % 8 == 0 ||
+      (inclusion_test & INCLUSION_IN && inclusion_test & INCLUSION_OUT))
+    return;
+
+  if (offsets.empty()) {
+    included.assign(points.size(), 1);
+    return;
+  }
+  if (!(inclusion_test & INCLUSION_ON))
+    return;
+
+  const bool inside = inclusion_test & INCLUSION_IN;
+  const bool outside = inclusion_test & INCLUSION_OUT;
+  parallel_for(points.size(), [&](int start, int end, int) {
+    for (int i = start; i < end; i++)
+      included[i] = !point_fails(points[i], inside, outside);
+  });
+}
+
+bool are_points_in_hull(const vector<Vec3d> &points, const Geometry &hull,
+                        unsigned int inclusion_test, const double &eps)
+{
+  return ConvexContainer(hull, eps).includes(points, inclusion_test);
 }
 
 // RK - Various find functions for geom
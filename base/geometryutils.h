@@ -162,9 +162,12 @@ make_face_from_contours(const std::vector<std::vector<int>> &contours,
  *   ELEM_EDGES an ELEM_FACES, to be coloured, based on the
  *   order position of the transformation that produced them.
  * \param clrngs an array of three Colorings applied, correspondingly, to the
- *  index coloured vertices, edges and faces.*/
+ *  index coloured vertices, edges and faces.
+ * \param num_threads the number of threads to divide the repeats between,
+ *  or \c 0 to use \c get_num_threads() */
 void sym_repeat(Geometry &geom, const Geometry &part, const Transformations &ts,
-                char col_part_elems = ELEM_NONE, Coloring *clrngs = nullptr);
+                char col_part_elems = ELEM_NONE, Coloring *clrngs = nullptr,
+                int num_threads = 0);
 
 /// Repeat a part by a set of symmetry transformations
 /**\param geom geometry to return the final model.
@@ -175,9 +178,12 @@ void sym_repeat(Geometry &geom, const Geometry &part, const Transformations &ts,
  *   order position of the transformation that produced them.
  * \param clrngs an array of three Colorings applied, correspondingly, to the
  *  index coloured vertices, edges and faces.
+ * \param num_threads the number of threads to divide the repeats between,
+ *  or \c 0 to use \c get_num_threads()
  * \return \c true if the symmetry group was valid, otherwise \c false. */
 bool sym_repeat(Geometry &geom, const Geometry &part, const Symmetry &sym,
-                char col_part_elems = ELEM_NONE, Coloring *clrngs = nullptr);
+                char col_part_elems = ELEM_NONE, Coloring *clrngs = nullptr,
+                int num_threads = 0);
 
 /// Repeat a part by a set of symmetry transformations
 /**\param geom geometry to return the final model.
@@ -391,6 +397,54 @@ bool face_bond(Geometry &base, Geometry &brick, int base_f_idx = 0,
 bool are_points_in_hull(const std::vector<Vec3d> &points, const Geometry &hull,
                         unsigned int inclusion_test, const double &eps);
 
+/// Convex hull prepared for testing many points
+/** The face planes of the hull are found once, and the tests give the same
+ *  results as \c are_points_in_hull(). */
+class ConvexContainer {
+private:
+  double eps;
+  Vec3d cent;
+  // outward face normals and their distances from the centre, by component
+  std::vector<double> norm_x;
+  std::vector<double> norm_y;
+  std::vector<double> norm_z;
+  std::vector<double> offsets;
+
+  bool point_fails(const Vec3d &P, bool inside, bool outside) const;
+
+public:
+  /// Constructor
+  /**\param hull geometry containing the convex hull
+   * \param eps a small number, coordinates differing by less than eps are
+   *  the same. */
+  ConvexContainer(const Geometry &hull, double eps = epsilon);
+
+  /// Are points in the container
+  /**\param points the points to test
+   * \param inclusion_test from ORing flags INCLUSION_IN, INCLUSION_ON
+   *  and INCLUSION_OUT
+   * \return \c true if all the points pass the test, otherwise \c false */
+  bool includes(const std::vector<Vec3d> &points,
+                unsigned int inclusion_test) const;
+
+  /// Is a point in the container
+  /**\param P the point to test
+   * \param inclusion_test from ORing flags INCLUSION_IN, INCLUSION_ON
+   *  and INCLUSION_OUT
+   * \return \c true if the point passes the test, otherwise \c false */
+  bool includes(const Vec3d &P, unsigned int inclusion_test) const;
+
+  /// Test each of a set of points, in parallel
+  /**\param points the points to test
+   * \param inclusion_test from ORing flags INCLUSION_IN, INCLUSION_ON
+   *  and INCLUSION_OUT
+   * \param included set to \c 1 for each point that passes the test,
+   *  otherwise \c 0 */
+  void find_included(const std::vector<Vec3d> &points,
+                     unsigned int inclusion_test,
+                     std::vector<char> &included) const;
+};
+
 /// Find the index number of a vertex with a set of coordinates
 /**\param geom the geometry
  * \param coords the coordinates
@@ -0,0 +1,148 @@
+/*
+   Copyright (c) 2026, Adrian Rossiter
+
+   Antiprism - http://www.antiprism.com
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+      The above copyright notice and this permission notice shall be included
+      in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+/* \file halfedge.cc
+   \brief Half-edge connectivity of faces
+*/
+
+#include "halfedge.h"
+#include "geometry.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+using std::pair;
+using std::vector;
+
+namespace anti {
+
+void HalfEdgeMesh::init(const Geometry &geom)
+{
+  const auto &faces = geom.faces();
+  face_starts.resize(faces.size() + 1);
+  face_starts[0] = 0;
+  for (unsigned int f_idx = 0; f_idx < faces.size(); f_idx++)
+    face_starts[f_idx + 1] = face_starts[f_idx] + faces[f_idx].size();
+  const int num_hes = face_starts.back();
+
+  he_verts.resize(num_hes);
+  for (unsigned int f_idx = 0; f_idx < faces.size(); f_idx++)
+    std::copy(faces[f_idx].begin(), faces[f_idx].end(),
+              he_verts.begin() + face_starts[f_idx]);
+
+  // Sort the half-edges by their vertex index pair, lower index first,
+  // keeping half-edge order for the half-edges on the same edge
+  he_faces.resize(num_hes);
+  vector<pair<uint64_t, int>> sorted(num_hes);
+  for (int f_idx = 0; f_idx < num_faces(); f_idx++) {
+    const int start = face_half_edge(f_idx);
+    const int end = face_half_edge(f_idx + 1);
+    for (int he = start; he < end; he++) {
+      he_faces[he] = f_idx;
+      uint32_t v0 = vert(he);
+      uint32_t v1 = vert((he + 1 < end) ? he + 1 : start);
+      if (v0 > v1)
+        std::swap(v0, v1);
+      sorted[he] = {((uint64_t)v0 << 32) | v1, he};
+    }
+  }
+  std::sort(sorted.begin(), sorted.end());
+
+  // Number the edges in sorted order, and link their half-edges
+  he_edges.resize(num_hes);
+  he_radials.resize(num_hes);
+  edge_verts.clear();
+  edge_first.clear();
+  edge_sizes.clear();
+  for (int i = 0; i < num_hes; i++) {
+    const int he = sorted[i].second;
+    if (i == 0 || sorted[i].first != sorted[i - 1].first) {
+      edge_verts.push_back(sorted[i].first >> 32);
+      edge_verts.push_back(sorted[i].first & 0xffffffff);
+      edge_first.push_back(he);
+      edge_sizes.push_back(0);
+    }
+    else
+      he_radials[sorted[i - 1].second] = he;
+    const int e_idx = edge_first.size() - 1;
+    he_edges[he] = e_idx;
+    he_radials[he] = edge_first[e_idx]; // last half-edge links to first
+    edge_sizes[e_idx]++;
+  }
+}
+
+vector<int> HalfEdgeMesh::edge_faces(int e_idx) const
+{
+  vector<int> e_faces;
+  e_faces.reserve(edge_sizes[e_idx]);
+  int he = edge_first[e_idx];
+  do {
+    e_faces.push_back(he_faces[he]);
+    he = he_radials[he];
+  } while (he != edge_first[e_idx]);
+  return e_faces;
+}
+
+int HalfEdgeMesh::find_edge(int v_idx0, int v_idx1) const
+{
+  if (v_idx0 > v_idx1)
+    std::swap(v_idx0, v_idx1);
+
+  // edges are sorted by their vertex index pair
+  int lo = 0;
+  int hi = num_edges();
+  while (lo < hi) {
+    const int mid = (lo + hi) / 2;
+    if (edge_verts[2 * mid] < v_idx0 ||
+        (edge_verts[2 * mid] == v_idx0 && edge_verts[2 * mid + 1] < v_idx1))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return (lo < num_edges() && edge_verts[2 * lo] == v_idx0 &&
+          edge_verts[2 * lo + 1] == v_idx1)
+             ? lo
+             : -1;
+}
+
+bool HalfEdgeMesh::is_oriented() const
+{
+  for (int e_idx = 0; e_idx < num_edges(); e_idx++) {
+    if (edge_sizes[e_idx] < 2)
+      continue;
+    // at most one half-edge can start at each vertex of the edge
+    int starts[2] = {0, 0};
+    int he = edge_first[e_idx];
+    do {
+      if (++starts[vert(he) != edge_verts[2 * e_idx]] > 1)
+        return false;
+      he = he_radials[he];
+    } while (he != edge_first[e_idx]);
+  }
+  return true;
+}
+
+} // namespace anti
@@ -0,0 +1,201 @@
+/*
+   Copyright (c) 2026, Adrian Rossiter
+
+   Antiprism - http://www.antiprism.com
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+      The above copyright notice and this permission notice shall be included
+      in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+/*!\file halfedge.h
+   \brief Half-edge connectivity of faces
+*/
+
+#ifndef HALFEDGE_H
+#define HALFEDGE_H
+
+#include <vector>
+
+namespace anti {
+
+class Geometry;
+
+/// Half-edge connectivity of the faces of a geometry
+/** Each side of a face is a half-edge, numbered consecutively through the
+ *  faces, so a half-edge is also a corner of the face at its start vertex.
+ *  The half-edges on the same (undirected) edge are linked in a circular
+ *  radial list, in half-edge order, so edges met by any number of faces
+ *  are supported. Edges are numbered in order of their vertex index pair,
+ *  lower index first, which is the order of the keys of
+ *  Geometry::get_edge_face_pairs(). The structure is built with a single
+ *  sort of the half-edges, and all navigation is by array lookup. Explicit
+ *  edges are not included. */
+class HalfEdgeMesh {
+private:
+  std::vector<int> he_verts;    // start vertex of each half-edge
+  std::vector<int> face_starts; // first half-edge of each face, and end
+  std::vector<int> he_faces;    // face of each half-edge
+  std::vector<int> he_edges;    // edge of each half-edge
+  std::vector<int> he_radials;  // next half-edge on the same edge
+  std::vector<int> edge_verts;  // vertex index pair of each edge
+  std::vector<int> edge_first;  // first half-edge of each edge
+  std::vector<int> edge_sizes;  // number of half-edges on each edge
+
+public:
+  /// Constructor
+  HalfEdgeMesh() = default;
+
+  /// Constructor
+  /**\param geom the geometry to find the connectivity of. */
+  HalfEdgeMesh(const Geometry &geom) { init(geom); }
+
+  /// Find the connectivity of a geometry
+  /**\param geom the geometry. */
+  void init(const Geometry &geom);
+
+  /// Get the number of faces
+  /**\return The number of faces. */
+  int num_faces() const
+  {
+    return face_starts.empty() ? 0 : (int)face_starts.size() - 1;
+  }
+
+  /// Get the number of half-edges
+  /**\return The number of half-edges, the total number of face sides. */
+  int num_half_edges() const { return he_faces.size(); }
+
+  /// Get the number of edges
+  /**\return The number of edges. */
+  int num_edges() const { return edge_first.size(); }
+
+  /// Get a half-edge of a face
+  /**\param f_idx the face index number.
+   * \param v_no the position of the start vertex in the face.
+   * \return The half-edge. */
+  int face_half_edge(int f_idx, int v_no = 0) const
+  {
+    return face_starts[f_idx] + v_no;
+  }
+
+  /// Get the number of sides of a face
+  /**\param f_idx the face index number.
+   * \return The number of sides. */
+  int face_size(int f_idx) const
+  {
+    return face_starts[f_idx + 1] - face_starts[f_idx];
+  }
+
+  /// Get the face of a half-edge
+  /**\param he the half-edge.
+   * \return The face index number. */
+  int face(int he) const { return he_faces[he]; }
+
+  /// Get the position of a half-edge in its face
+  /**\param he the half-edge.
+   * \return The position of the start vertex of the half-edge. */
+  int face_pos(int he) const { return he - face_half_edge(he_faces[he]); }
+
+  /// Get the start vertex of a half-edge
+  /**\param he the half-edge.
+   * \return The vertex index number. */
+  int vert(int he) const { return he_verts[he]; }
+
+  /// Get the end vertex of a half-edge
+  /**\param he the half-edge.
+   * \return The vertex index number. */
+  int vert_to(int he) const { return vert(next(he)); }
+
+  /// Get the next half-edge around the face
+  /**\param he the half-edge.
+   * \return The half-edge. */
+  int next(int he) const
+  {
+    const int f_idx = he_faces[he];
+    return (he + 1 < face_half_edge(f_idx + 1)) ? he + 1
+                                                 : face_half_edge(f_idx);
+  }
+
+  /// Get the previous half-edge around the face
+  /**\param he the half-edge.
+   * \return The half-edge. */
+  int prev(int he) const
+  {
+    const int f_idx = he_faces[he];
+    return (he > face_half_edge(f_idx)) ? he - 1
+                                        : face_half_edge(f_idx + 1) - 1;
+  }
+
+  /// Get the next half-edge on the same edge
+  /**\param he the half-edge.
+   * \return The half-edge, which is \a he if it is the only one. */
+  int radial(int he) const { return he_radials[he]; }
+
+  /// Get the opposite half-edge
+  /**\param he the half-edge.
+   * \return The other half-edge on the edge, or \c -1 if the edge does
+   *  not have exactly two half-edges. */
+  int twin(int he) const
+  {
+    return (edge_sizes[he_edges[he]] == 2) ? he_radials[he] : -1;
+  }
+
+  /// Get the edge of a half-edge
+  /**\param he the half-edge.
+   * \return The edge index number. */
+  int edge(int he) const { return he_edges[he]; }
+
+  /// Get the number of half-edges on an edge
+  /**\param e_idx the edge index number.
+   * \return The number of half-edges, which is the number of face sides
+   *  on the edge. */
+  int edge_size(int e_idx) const { return edge_sizes[e_idx]; }
+
+  /// Get the first half-edge on an edge
+  /**\param e_idx the edge index number.
+   * \return The half-edge with the lowest number on the edge. */
+  int edge_half_edge(int e_idx) const { return edge_first[e_idx]; }
+
+  /// Get a vertex of an edge
+  /**\param e_idx the edge index number.
+   * \param v_no \c 0 for the lower vertex index, \c 1 for the higher.
+   * \return The vertex index number. */
+  int edge_vert(int e_idx, int v_no) const
+  {
+    return edge_verts[2 * e_idx + v_no];
+  }
+
+  /// Get the faces on an edge
+  /**\param e_idx the edge index number.
+   * \return The face of each half-edge on the edge, in half-edge order. */
+  std::vector<int> edge_faces(int e_idx) const;
+
+  /// Find an edge
+  /**\param v_idx0 index number of a vertex.
+   * \param v_idx1 index number of a vertex.
+   * \return The edge index number, or \c -1 if there is no such edge. */
+  int find_edge(int v_idx0, int v_idx1) const;
+
+  /// Check if the faces are oriented
+  /**\return \c true if no two faces share an edge in the same direction,
+   *  otherwise \c false. */
+  bool is_oriented() const;
+};
+
+} // namespace anti
+
+#endif // HALFEDGE_H
@@ -29,15 +29,28 @@
 #include "polygon.h"
 #include "private_off_file.h"
 #include "private_std_polys.h"
+#include "threads.h"
 #include "utils.h"
 
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
 #include <algorithm>
+#include <climits>
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <string>
 #include <vector>
 
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 using std::string;
 using std::to_string;
 using std::vector;
@@ -88,10 +101,12 @@ Status off_file_read(string file_name, Geometry &geom)
   return stat;
 }
 
-Status add_vert(Geometry &geom, const vector<char *> &vals)
+// don't export these functions
+namespace {
+
+Status read_vert(const vector<char *> &vals, Vec3d &v)
 {
   Status stat;
-  Vec3d v;
   for (unsigned int i = 0; (i < vals.size() && i < 3); i++) {
     if (!(stat = read_double_noparse(vals[i], &v[i])))
       return Status::error(
@@ -101,13 +116,11 @@ Status add_vert(Geometry &geom, const vector<char *> &vals)
   if (vals.size() < 3)
     return Status::error("vertex coords: less than three coordinates");
 
-  geom.add_vert(v);
-
   return Status::ok();
 }
 
-Status add_face(Geometry &geom, vector<char *> vals, Geometry &alt_cols,
-                bool *contains_int_gt_1, bool *contains_adj_equal_idx)
+Status read_face(vector<char *> vals, int last_vert, vector<int> &face,
+                 Color &col, int *col_type, bool *contains_adj_equal_idx)
 {
   Status stat;
   int face_sz;
@@ -122,13 +135,12 @@ Status add_face(Geometry &geom, vector<char *> vals, Geometry &alt_cols,
         msg_str("face size: '%d', must be 1 or more", face_sz));
 
   *contains_adj_equal_idx = false;
-  vector<int> face(face_sz);
+  face.resize(face_sz);
   for (unsigned int i = 1; (i < vals.size() && (int)i <= face_sz); i++) {
     if (!(stat = read_int(vals[i], &face[i - 1])))
       return Status::error(
           msg_str("face index: '%s' %s", vals[i], stat.c_msg()));
 
-    int last_vert = geom.verts().size() - 1;
     if (face[i - 1] < 0 || face[i - 1] > last_vert)
       return Status::error(msg_str("face index: '%s' is not in range 0 to %d",
                                    vals[i], last_vert));
@@ -143,42 +155,618 @@ Status add_face(Geometry &geom, vector<char *> vals, Geometry &alt_cols,
     return Status::error(msg_str("face: less than %d values", face_sz));
 
   vals.erase(vals.begin(), vals.begin() + face_sz + 1);
-  int col_type;
-  Color col, alt_col;
-  if (!(stat = col.from_offvals(vals, &col_type)))
+  if (!(stat = col.from_offvals(vals, col_type)))
     return Status::error(
         msg_str("face colour: invalid colour: %s", stat.c_msg()));
 
-  alt_col = col;
-  if (col_type == 3 || col_type == 4) { // read as integers
-    if (col[0] > 1 || col[1] > 1 || col[2] > 1 || (col_type == 4 && col[3] > 1))
-      *contains_int_gt_1 = true;
-    else // store alternative colour with integres taken as floats
-      alt_col = Color(col[0] * 255, col[1] * 255, col[2] * 255,
-                      col_type == 4 ? col[3] * 255 : 255);
+  return Status::ok();
+}
+
+// Whitespace, as used to split lines into values
+inline bool is_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' ||
+         c == '\v';
+}
+
+// Get the next value in a line, return false if there are no more values
+inline bool next_val(const char *&p, const char *end, const char *&val,
+                     const char *&val_end)
+{
+  while (p < end && is_space(*p))
+    p++;
+  if (p == end)
+    return false;
+  val = p;
+  while (p < end && !is_space(*p))
+    p++;
+  val_end = p;
+  return true;
+}
+
+inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+// Read a plain integer value, otherwise return false to use read_int()
+bool fast_int(const char *p, const char *end, int *num)
+{
+  bool neg = false;
+  if (p < end && (*p == '-' || *p == '+'))
+    neg = (*p++ == '-');
+  if (p == end)
+    return false;
+  while (p < end - 1 && *p == '0') // leading zeros
+    p++;
+  if (end - p > 9) // may not fit in an int, or be too large for read_int()
+    return false;
+  int val = 0;
+  for (; p < end; p++) {
+    if (!is_digit(*p))
+      return false;
+    val = 10 * val + (*p - '0');
   }
+  *num = (neg) ? -val : val;
+  return true;
+}
 
-  int idx;
-  if (face_sz == 1) { // vertex element, only need to set colour
-    geom.colors(VERTS).set(face[0], col);
-    alt_cols.colors(VERTS).set(face[0], alt_col);
+// Read a plain decimal value, otherwise return false to use
+// read_double_noparse(), which also handles the 'sqrt' prefix.
+bool fast_double(const char *p, const char *end, double *num)
+{
+  char buf[64];
+  const size_t len = end - p;
+  if (len >= sizeof(buf))
+    return false;
+
+  const char *q = p;
+  if (q < end && (*q == '-' || *q == '+'))
+    q++;
+  int num_digits = 0;
+  for (; q < end && is_digit(*q); q++)
+    num_digits++;
+  if (q < end && *q == '.')
+    for (q++; q < end && is_digit(*q); q++)
+      num_digits++;
+  if (!num_digits)
+    return false;
+  if (q < end && (*q == 'e' || *q == 'E')) {
+    q++;
+    if (q < end && (*q == '-' || *q == '+'))
+      q++;
+    int num_exp_digits = 0;
+    for (; q < end && is_digit(*q); q++)
+      num_exp_digits++;
+    if (!num_exp_digits)
+      return false;
   }
-  else if (face_sz == 2) { // digon edge element
-    idx = geom.add_edge(face);
-    geom.colors(EDGES).set(idx, col);
-    alt_cols.colors(EDGES).set(idx, alt_col);
+  if (q != end)
+    return false;
+
+  memcpy(buf, p, len);
+  buf[len] = '\0';
+  *num = strtod(buf, nullptr);
+  return std::isfinite(*num);
+}
+
+// Split a copy of a line into values, without using strtok
+void split_copy(const char *p, const char *end, string &buf,
+                vector<char *> &vals)
+{
+  buf.assign(p, end);
+  vals.clear();
+  char *q = &buf[0];
+  char *q_end = q + buf.size();
+  while (true) {
+    while (q < q_end && is_space(*q))
+      q++;
+    if (q == q_end)
+      break;
+    vals.push_back(q);
+    while (q < q_end && !is_space(*q))
+      q++;
+    if (q < q_end)
+      *q++ = '\0';
   }
-  else { // face element
-    idx = geom.add_face(face);
-    geom.colors(FACES).set(idx, col);
-    alt_cols.colors(FACES).set(idx, alt_col);
+}
+
+// Read a vertex line
+Status vert_line_read(const char *line, const char *end, Vec3d &v)
+{
+  const char *p = line;
+  const char *val, *val_end;
+  int i = 0;
+  for (; i < 3 && next_val(p, end, val, val_end); i++)
+    if (!fast_double(val, val_end, &v[i]))
+      break;
+  if (i == 3)
+    return Status::ok();
+
+  string buf;
+  vector<char *> vals;
+  split_copy(line, end, buf, vals);
+  return read_vert(vals, v);
+}
+
+// A face line, holding a vertex, edge or face element
+struct FaceLine {
+  vector<int> face;
+  Color col;
+  int col_type;
+};
+
+// Read a face line in the common formats, otherwise return false
+bool fast_face_line_read(const char *p, const char *end, int last_vert,
+                         FaceLine &fline, bool *contains_adj_equal_idx)
+{
+  const char *val, *val_end;
+  int face_sz;
+  if (!next_val(p, end, val, val_end) || !fast_int(val, val_end, &face_sz) ||
+      face_sz < 1)
+    return false;
+
+  *contains_adj_equal_idx = false;
+  auto &face = fline.face;
+  face.resize(face_sz);
+  for (int i = 0; i < face_sz; i++) {
+    if (!next_val(p, end, val, val_end) || !fast_int(val, val_end, &face[i]) ||
+        face[i] < 0 || face[i] > last_vert)
+      return false;
+    if (i > 0 && face[i] == face[i - 1])
+      *contains_adj_equal_idx = true;
   }
+  if (face_sz > 1 && face[0] == face[face_sz - 1])
+    *contains_adj_equal_idx = true;
 
-  return Status::ok();
+  const char *col_vals[4][2];
+  int num_col_vals = 0;
+  while (next_val(p, end, val, val_end)) {
+    if (num_col_vals == 4)
+      return false;
+    col_vals[num_col_vals][0] = val;
+    col_vals[num_col_vals][1] = val_end;
+    num_col_vals++;
+  }
+
+  fline.col = Color();
+  if (num_col_vals == 0)
+    fline.col_type = 0;
+  else if (num_col_vals == 1) {
+    int idx;
+    if (!fast_int(col_vals[0][0], col_vals[0][1], &idx) || idx < 0)
+      return false;
+    fline.col = Color(idx);
+    fline.col_type = 1;
+  }
+  else if (num_col_vals >= 3) {
+    int ivals[4] = {0, 0, 0, 255};
+    int i = 0;
+    for (; i < num_col_vals; i++)
+      if (!fast_int(col_vals[i][0], col_vals[i][1], &ivals[i]))
+        break;
+    if (i == num_col_vals) { // integer format
+      for (int j = 0; j < 4; j++)
+        if (ivals[j] < 0 || ivals[j] > 255)
+          return false;
+      fline.col.set_rgba(ivals[0], ivals[1], ivals[2], ivals[3]);
+      fline.col_type = 3 + (num_col_vals == 4);
+    }
+    else { // decimal format
+      double dvals[4] = {0.0, 0.0, 0.0, 1.0};
+      for (int j = 0; j < num_col_vals; j++)
+        if (!fast_double(col_vals[j][0], col_vals[j][1], &dvals[j]) ||
+            dvals[j] < 0 || dvals[j] > 1)
+          return false;
+      fline.col.set_rgba(dvals[0], dvals[1], dvals[2], dvals[3]);
+      fline.col_type = 5 + (num_col_vals == 4);
+    }
+  }
+  else
+    return false;
+
+  return true;
+}
+
+// Read a face line
+Status face_line_read(const char *p, const char *end, int last_vert,
+                      FaceLine &fline, bool *contains_adj_equal_idx)
+{
+  if (fast_face_line_read(p, end, last_vert, fline, contains_adj_equal_idx))
+    return Status::ok();
+
+  string buf;
+  vector<char *> vals;
+  split_copy(p, end, buf, vals);
+  return read_face(vals, last_vert, fline.face, fline.col, &fline.col_type,
+                   contains_adj_equal_idx);
+}
+
+// Contents of a file stream from the current position, mapped into memory
+// for a regular file if possible, otherwise read into a buffer. Characters
+// already read from the stream may be included at the start.
+class FileData {
+private:
+  const char *data = nullptr;
+  size_t len = 0;
+  void *map = nullptr;
+  size_t map_len = 0;
+  vector<char> buf;
+
+public:
+  FileData(FILE *ifile, const char *prev = "", size_t prev_len = 0);
+  ~FileData();
+  FileData(const FileData &) = delete;
+  FileData &operator=(const FileData &) = delete;
+
+  const char *begin() const { return data; }
+  const char *end() const { return data + len; }
+  size_t size() const { return len; }
+};
+
+FileData::FileData(FILE *ifile, const char *prev, size_t prev_len)
+{
+#ifdef HAVE_MMAP
+  struct stat st;
+  long pos = ftell(ifile) - prev_len;
+  if (pos >= 0 && fstat(fileno(ifile), &st) == 0 && S_ISREG(st.st_mode) &&
+      st.st_size > pos) {
+    map_len = st.st_size;
+    map = mmap(nullptr, map_len, PROT_READ, MAP_PRIVATE, fileno(ifile), 0);
+    if (map != MAP_FAILED) {
+      data = static_cast<const char *>(map) + pos;
+      len = map_len - pos;
+      return;
+    }
+    map = nullptr;
+  }
+#endif
+
+  const size_t chunk_sz = 1 << 20;
+  buf.assign(prev, prev + prev_len);
+  size_t num_read;
+  do {
+    size_t buf_sz = buf.size();
+    buf.resize(buf_sz + chunk_sz);
+    num_read = fread(&buf[buf_sz], 1, chunk_sz, ifile);
+    buf.resize(buf_sz + num_read);
+  } while (num_read == chunk_sz);
+  data = buf.data();
+  len = buf.size();
+}
+
+FileData::~FileData()
+{
+#ifdef HAVE_MMAP
+  if (map)
+    munmap(map, map_len);
+#endif
+}
+
+// A block of whole lines of the OFF data, processed on one thread
+struct LineChunk {
+  const char *begin;
+  const char *end;
+  int num_lines = 0;      // number of lines
+  int num_data_lines = 0; // number of non-blank lines
+  int first_line_no = 0;  // file line number of the first line
+  int first_data_idx = 0; // index number of the first non-blank line
+  int err_line_no = 0;    // line number of an error, or 0
+  string err_msg;
+  bool contains_int_gt_1 = false;
+  vector<int> adj_equal_idx_lines;
+};
+
+// Get the end of a line, and the end of the line data before any comment
+inline const char *line_end(const char *p, const char *end,
+                            const char **data_end)
+{
+  const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+  if (!eol)
+    eol = end;
+  *data_end = static_cast<const char *>(memchr(p, '#', eol - p));
+  if (!*data_end)
+    *data_end = eol;
+  return eol;
+}
+
+inline bool is_blank(const char *p, const char *end)
+{
+  for (; p < end; p++)
+    if (!is_space(*p))
+      return false;
+  return true;
+}
+
+// Count the lines, and the non-blank lines, in a chunk
+void count_lines(LineChunk &chunk)
+{
+  const char *data_end;
+  for (const char *p = chunk.begin; p < chunk.end;) {
+    const char *eol = line_end(p, chunk.end, &data_end);
+    chunk.num_lines++;
+    if (!is_blank(p, data_end))
+      chunk.num_data_lines++;
+    p = (eol < chunk.end) ? eol + 1 : chunk.end;
+  }
+}
+
+// First few line numbers for faces with adjacent verts with equal indexs
+const unsigned int max_adj_equal_idx_lines = 6;
+
+// Read the lines in a chunk, stopping at the first error
+void read_lines(LineChunk &chunk, int num_pts, int num_faces, int last_vert,
+                Vec3d *verts, FaceLine *flines)
+{
+  int line_no = chunk.first_line_no;
+  int data_idx = chunk.first_data_idx;
+  const char *data_end;
+  for (const char *p = chunk.begin; p < chunk.end; line_no++) {
+    const char *line = p;
+    const char *eol = line_end(p, chunk.end, &data_end);
+    p = (eol < chunk.end) ? eol + 1 : chunk.end;
+    if (is_blank(line, data_end))
+      continue; // skip the line
+
+    Status stat;
+    if (data_idx < num_pts) // vertex line
+      stat = vert_line_read(line, data_end, verts[data_idx]);
+    else if (data_idx < num_pts + num_faces) { // face line
+      FaceLine &fline = flines[data_idx - num_pts];
+      bool contains_adj_equal_idx = false;
+      if ((stat = face_line_read(line, data_end, last_vert, fline,
+                                 &contains_adj_equal_idx))) {
+        // only record the first few lines of elements with seq equal indexes
+        if (contains_adj_equal_idx &&
+            chunk.adj_equal_idx_lines.size() < max_adj_equal_idx_lines)
+          chunk.adj_equal_idx_lines.push_back(line_no);
+        const Color &col = fline.col;
+        if ((fline.col_type == 3 || fline.col_type == 4) &&
+            (col[0] > 1 || col[1] > 1 || col[2] > 1 ||
+             (fline.col_type == 4 && col[3] > 1)))
+          chunk.contains_int_gt_1 = true;
+      }
+    }
+    else // extra data at end
+      stat = Status::error("data at end of file");
+
+    if (stat.is_error()) {
+      chunk.err_line_no = line_no;
+      chunk.err_msg = msg_str("line %d: ", line_no) + stat.msg();
+      return;
+    }
+    data_idx++;
+  }
+}
+
+// Get a value stored in little-endian order
+template <typename T> T get_le(const char *p)
+{
+  T val;
+  if (host_is_little_endian())
+    memcpy(&val, p, sizeof(T));
+  else {
+    char *q = reinterpret_cast<char *>(&val);
+    for (unsigned int i = 0; i < sizeof(T); i++)
+      q[i] = p[sizeof(T) - 1 - i];
+  }
+  return val;
+}
+
+// Set colours from a colour block, p is advanced past the block
+void bin_cols_read(const char *&p, int num, int offset, ElemProps<Color> &cols)
+{
+  for (int i = 0; i < num; i++) {
+    int idx = get_le<int32_t>(p);
+    if (idx >= 0)
+      cols.set(i + offset, Color(idx));
+    else if (idx == -1)
+      cols.set(i + offset, Color((unsigned char)p[4], (unsigned char)p[5],
+                                 (unsigned char)p[6], (unsigned char)p[7]));
+    p += off_bin_col_sz;
+  }
+}
+
+// Read a binary OFF file, the first byte of the signature has been read
+Status off_bin_file_read(FILE *ifile, Geometry &geom)
+{
+#ifdef HAVE_MMAP
+  // map a regular file into memory rather than copying it
+  struct stat st;
+  long pos = ftell(ifile) - 1; // position of the signature
+  if (pos >= 0 && fstat(fileno(ifile), &st) == 0 && S_ISREG(st.st_mode) &&
+      st.st_size > pos) {
+    size_t map_len = st.st_size;
+    void *map =
+        mmap(nullptr, map_len, PROT_READ, MAP_PRIVATE, fileno(ifile), 0);
+    if (map != MAP_FAILED) {
+      Status stat = off_bin_read(static_cast<const char *>(map) + pos,
+                                 map_len - pos, geom);
+      munmap(map, map_len);
+      return stat;
+    }
+  }
+#endif
+
+  // read the whole stream into a buffer
+  const size_t chunk_sz = 1 << 20;
+  vector<char> buf(1, off_bin_magic[0]);
+  size_t num_read;
+  do {
+    size_t buf_sz = buf.size();
+    buf.resize(buf_sz + chunk_sz);
+    num_read = fread(&buf[buf_sz], 1, chunk_sz, ifile);
+    buf.resize(buf_sz + num_read);
+  } while (num_read == chunk_sz);
+
+  return off_bin_read(buf.data(), buf.size(), geom);
+}
+
+} // namespace
+
+Status off_bin_read(const char *data, size_t len, Geometry &geom)
+{
+  if (len < off_bin_header_sz)
+    return Status::error("binary OFF: incomplete header");
+
+  if (memcmp(data, off_bin_magic, off_bin_magic_len) != 0)
+    return Status::error("binary OFF: invalid signature");
+
+  const char *p = data + off_bin_magic_len;
+  unsigned int version = get_le<uint32_t>(p);
+  if (version != off_bin_version)
+    return Status::error(
+        msg_str("binary OFF: unsupported format version %u", version));
+  unsigned int flags = get_le<uint32_t>(p + 4);
+  const unsigned int known_flags =
+      off_bin_vert_cols | off_bin_edge_cols | off_bin_face_cols;
+  if (flags & ~known_flags)
+    return Status::error(
+        msg_str("binary OFF: unsupported flags 0x%x", flags & ~known_flags));
+  uint64_t cnts[4]; // vertices, faces, face indexes, edges
+  for (int i = 0; i < 4; i++) {
+    cnts[i] = get_le<uint64_t>(p + 8 + 8 * i);
+    if (cnts[i] > INT_MAX)
+      return Status::error("binary OFF: element counts: count is too large");
+  }
+  const int num_verts = cnts[0];
+  const int num_faces = cnts[1];
+  const int num_face_idxs = cnts[2];
+  const int num_edges = cnts[3];
+
+  if (num_verts == 0 && num_faces != 0)
+    return Status::error("binary OFF: element counts: cannot have a positive "
+                         "face count if vertex count is zero");
+
+  // all counts are less than 2^31, so the size cannot overflow
+  uint64_t data_sz = off_bin_header_sz + 24 * cnts[0] + 8 * (cnts[1] + 1) +
+                     4 * cnts[2] + 8 * cnts[3];
+  if (flags & off_bin_vert_cols)
+    data_sz += off_bin_col_sz * cnts[0];
+  if (flags & off_bin_edge_cols)
+    data_sz += off_bin_col_sz * cnts[3];
+  if (flags & off_bin_face_cols)
+    data_sz += off_bin_col_sz * cnts[1];
+  if (len < data_sz)
+    return Status::error(
+        msg_str("binary OFF: file is truncated (%lu bytes, expected %lu)",
+                (unsigned long)len, (unsigned long)data_sz));
+  if (len > data_sz)
+    return Status::error("binary OFF: data at end of file");
+
+  p = data + off_bin_header_sz;
+  const int v_offset = geom.verts().size();
+  const int last_vert = v_offset + num_verts - 1;
+  auto &verts = geom.raw_verts();
+  verts.reserve(v_offset + num_verts);
+  for (int i = 0; i < num_verts; i++, p += 24)
+    verts.push_back(Vec3d(get_le<double>(p), get_le<double>(p + 8),
+                          get_le<double>(p + 16)));
+
+  const char *offs = p;
+  const char *idxs = offs + 8 * (num_faces + 1);
+  if (get_le<uint64_t>(offs) != 0 ||
+      get_le<uint64_t>(offs + 8 * num_faces) != cnts[2]) {
+    geom.clear_all();
+    return Status::error("binary OFF: face offsets: do not span face indexes");
+  }
+
+  // First few face numbers for faces with adjacent verts with equal indexs
+  const unsigned int max_adj_equal_idx_faces = 6;
+  vector<int> adj_equal_idx_faces;
+
+  const int f_offset = geom.faces().size();
+  auto &faces = geom.raw_faces();
+  faces.resize(f_offset + num_faces);
+  for (int i = 0; i < num_faces; i++) {
+    uint64_t start = get_le<uint64_t>(offs + 8 * i);
+    uint64_t end = get_le<uint64_t>(offs + 8 * (i + 1));
+    if (end > (uint64_t)num_face_idxs) {
+      geom.clear_all();
+      return Status::error(
+          msg_str("binary OFF: face %d: offset %lu and size %ld go past the "
+                  "%d face indexes",
+                  i, (unsigned long)start, (long)(end - start),
+                  num_face_idxs));
+    }
+    if (end <= start) {
+      geom.clear_all();
+      return Status::error(
+          msg_str("binary OFF: face %d: size must be 1 or more", i));
+    }
+    auto &face = faces[f_offset + i];
+    face.resize(end - start);
+    for (unsigned int j = 0; j < face.size(); j++) {
+      face[j] = get_le<int32_t>(idxs + 4 * (start + j));
+      if (face[j] < 0 || face[j] > last_vert) {
+        int bad_idx = face[j];
+        geom.clear_all();
+        return Status::error(
+            msg_str("binary OFF: face %d: index '%d' is not in range 0 to %d",
+                    i, bad_idx, last_vert));
+      }
+    }
+    if (adj_equal_idx_faces.size() < max_adj_equal_idx_faces) {
+      for (unsigned int j = 0; j < face.size(); j++)
+        if (face.size() > 1 && face[j] == face[(j + 1) % face.size()]) {
+          adj_equal_idx_faces.push_back(i);
+          break;
+        }
+    }
+  }
+  p = idxs + 4 * cnts[2];
+
+  const int e_offset = geom.edges().size();
+  for (int i = 0; i < num_edges; i++, p += 8) {
+    vector<int> edge = {get_le<int32_t>(p), get_le<int32_t>(p + 4)};
+    for (int v_idx : edge)
+      if (v_idx < 0 || v_idx > last_vert) {
+        geom.clear_all();
+        return Status::error(
+            msg_str("binary OFF: edge %d: index '%d' is not in range 0 to %d",
+                    i, v_idx, last_vert));
+      }
+    geom.add_edge_raw(edge);
+  }
+
+  if (flags & off_bin_vert_cols)
+    bin_cols_read(p, num_verts, v_offset, geom.colors(VERTS));
+  if (flags & off_bin_edge_cols)
+    bin_cols_read(p, num_edges, e_offset, geom.colors(EDGES));
+  if (flags & off_bin_face_cols)
+    bin_cols_read(p, num_faces, f_offset, geom.colors(FACES));
+
+  string message;
+  if (adj_equal_idx_faces.size()) {
+    message = "face";
+    message += ((adj_equal_idx_faces.size() > 1) ? "s " : " ");
+    for (unsigned int i = 0; i < adj_equal_idx_faces.size() &&
+                             i < max_adj_equal_idx_faces - 1;
+         i++)
+      message += std::to_string(adj_equal_idx_faces[i]) + ", ";
+
+    if (adj_equal_idx_faces.size() == max_adj_equal_idx_faces)
+      message += "..."; // the unmentioned last face and any others
+    else
+      message.resize(message.size() - 2); // the list was complete
+
+    message += ": face element has adjacent vertices with the same index "
+               "number";
+  }
+
+  if (!geom.is_set())
+    return Status::error("no vertices (empty geometry)");
+
+  return message.empty() ? Status::ok()
+                         : Status::warning("binary OFF: " + message);
 }
 
 Status off_file_read(FILE *ifile, Geometry &geom)
 {
+  // check for binary OFF
+  int first_char = getc(ifile);
+  if (first_char == (unsigned char)off_bin_magic[0])
+    return off_bin_file_read(ifile, geom);
+  else if (first_char != EOF)
+    ungetc(first_char, ifile);
+
   int file_line_no = 0; // line number in the file
 
   // read OFF type
@@ -232,60 +820,102 @@ Status off_file_read(FILE *ifile, Geometry &geom)
                                  "positive face count if vertex count is zero ",
                                  file_line_no));
 
-  int data_line_no = 2; // non blank lines
-
   // Variables so that if all integer color values
   // are 0 or 1, then they are all converted to decimals
   bool contains_int_gt_1 = false;
-  Geometry alt_cols;
 
-  // First few line numbers for faces with adjacent verts with equal indexs
-  const unsigned int max_adj_equal_idx_lines = 6;
   vector<int> adj_equal_idx_lines;
 
-  // read coords
-  while (read_off_line(ifile, &line) == 0) {
-    file_line_no++;
-
-    Split vals(line);
-    if (!vals.size()) // line was blank
-      continue;       // skip the line
+  // Divide the rest of the file into chunks of whole lines, count the
+  // lines in each chunk and then read them, processing chunks in parallel
+  FileData file_data(ifile);
+  const size_t min_chunk_sz = 1 << 18;
+  const int num_chunks = parallel_blocks(
+      std::max(file_data.size() / min_chunk_sz, (size_t)1), 0, 1);
+  vector<LineChunk> chunks(num_chunks);
+  const char *p = file_data.begin();
+  for (int i = 0; i < num_chunks; i++) {
+    chunks[i].begin = p;
+    if (i < num_chunks - 1) {
+      p = std::max(p, file_data.begin() + file_data.size() * (i + 1) /
+                                             num_chunks);
+      const char *eol =
+          static_cast<const char *>(memchr(p, '\n', file_data.end() - p));
+      p = (eol) ? eol + 1 : file_data.end();
+    }
+    else
+      p = file_data.end();
+    chunks[i].end = p;
+  }
 
-    data_line_no++;
+  parallel_for(
+      num_chunks,
+      [&](int start, int end, int) {
+        for (int i = start; i < end; i++)
+          count_lines(chunks[i]);
+      },
+      num_chunks, 1);
+
+  int num_data_lines = 0;
+  for (auto &chunk : chunks) {
+    chunk.first_line_no = file_line_no + 1;
+    chunk.first_data_idx = num_data_lines;
+    file_line_no += chunk.num_lines;
+    num_data_lines += chunk.num_data_lines;
+  }
 
-    Status stat;
-    if (data_line_no <= 2 + num_pts) { // vertex line
-      if (!(stat = add_vert(geom, vals.get_parts()))) {
-        message = msg_str("line %d: ", file_line_no) + stat.msg();
-        geom.clear_all();
-        break;
-      }
-    }
-    else if (data_line_no <= 2 + num_pts + num_faces) { // face line
-      bool contains_adj_equal_idx = false;
-      if (!(stat = add_face(geom, vals.get_parts(), alt_cols,
-                            &contains_int_gt_1, &contains_adj_equal_idx))) {
-        message = msg_str("line %d: ", file_line_no) + stat.msg();
-        geom.clear_all();
-        break;
-      }
-      // only record the first few lines of elements with seq equal indexes
-      if (contains_adj_equal_idx &&
-          adj_equal_idx_lines.size() < max_adj_equal_idx_lines)
-        adj_equal_idx_lines.push_back(file_line_no);
-    }
-    else { // extra data at end
-      message = msg_str("line %d: data at end of file", file_line_no);
-      geom.clear_all();
+  const int v_offset = geom.verts().size();
+  const int last_vert = v_offset + num_pts - 1;
+  geom.raw_verts().resize(v_offset + std::min(num_data_lines, num_pts));
+  vector<FaceLine> flines(
+      std::max(std::min(num_data_lines - num_pts, num_faces), 0));
+  Vec3d *verts = geom.raw_verts().data() + v_offset;
+
+  parallel_for(
+      num_chunks,
+      [&](int start, int end, int) {
+        for (int i = start; i < end; i++)
+          read_lines(chunks[i], num_pts, num_faces, last_vert, verts,
+                     flines.data());
+      },
+      num_chunks, 1);
+
+  bool has_error = false;
+  for (auto &chunk : chunks) {
+    for (int line_no : chunk.adj_equal_idx_lines)
+      if (adj_equal_idx_lines.size() < max_adj_equal_idx_lines)
+        adj_equal_idx_lines.push_back(line_no);
+    contains_int_gt_1 |= chunk.contains_int_gt_1;
+    if (chunk.err_line_no) { // first error in the file
+      message = chunk.err_msg;
+      has_error = true;
       break;
     }
-    free(line);
   }
 
-  free(line);
-
-  if (!contains_int_gt_1)
-    geom.get_cols() = alt_cols.get_cols();
+  if (has_error)
+    geom.clear_all();
+  else {
+    auto &faces = geom.raw_faces();
+    faces.reserve(faces.size() + flines.size());
+    for (auto &fline : flines) {
+      Color col = fline.col;
+      if (!contains_int_gt_1 && (fline.col_type == 3 || fline.col_type == 4))
+        // store integers as floats
+        col = Color(col[0] * 255, col[1] * 255, col[2] * 255,
+                    fline.col_type == 4 ? col[3] * 255 : 255);
+
+      const int face_sz = fline.face.size();
+      if (face_sz == 1) // vertex element, only need to set colour
+        geom.colors(VERTS).set(fline.face[0], col);
+      else if (face_sz == 2) // digon edge element
+        geom.colors(EDGES).set(geom.add_edge(fline.face), col);
+      else { // face element
+        geom.colors(FACES).set(faces.size(), col);
+        faces.push_back(std::move(fline.face));
+      }
+    }
+  }
 
   // create warning message for adjacent equal vertex numbers on faces
   if (adj_equal_idx_lines.size()) {
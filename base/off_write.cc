@@ -27,26 +27,30 @@
 */
 
 #include "private_off_file.h"
+#include "threads.h"
 #include "utils.h"
 
 #include <algorithm>
 #include <cerrno>
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
+#include <unordered_map>
 #include <vector>
 
 using std::map;
 using std::string;
 using std::vector;
 
-FILE *file_open_w(string file_name, string &error_msg)
+FILE *file_open_w(string file_name, string &error_msg, const char *mode = "w")
 {
   error_msg.clear();
   FILE *ofile = stdout; // write to stdout by default
   if (file_name != "") {
-    ofile = fopen(file_name.c_str(), "w");
+    ofile = fopen(file_name.c_str(), mode);
     if (!ofile)
       error_msg = "could not open file for writing '" + file_name +
                   "': " + strerror(errno);
@@ -60,26 +64,6 @@ void file_close_w(FILE *ofile)
     fclose(ofile);
 }
 
-void crds_write(FILE *ofile, const Geometry &geom, const char *sep,
-                int sig_dgts)
-{
-  for (unsigned int i = 0; i < geom.verts().size(); i++)
-    fprintf(ofile, "%s\n", geom.verts(i).to_str(sep, sig_dgts).c_str());
-}
-
-Status crds_write(string file_name, const Geometry &geom, const char *sep,
-                  int sig_dgts)
-{
-  string error_msg;
-  FILE *ofile = file_open_w(file_name, error_msg);
-  if (!ofile)
-    return Status::error(error_msg);
-
-  crds_write(ofile, geom, sep, sig_dgts);
-  file_close_w(ofile);
-  return Status::ok();
-}
-
 // don't export these functions
 namespace {
 
@@ -125,6 +109,137 @@ string off_col(Color col)
     return string();
 }
 
+// don't export these functions
+namespace {
+
+// Format OFF text into a reusable buffer, and write it in blocks
+class TextBuffer {
+private:
+  vector<char> buf;
+  std::unordered_map<uint64_t, string> col_strs; // colour string cache
+
+public:
+  void clear() { buf.clear(); }
+  void write(FILE *ofile) const { fwrite(buf.data(), 1, buf.size(), ofile); }
+
+  void put(char c) { buf.push_back(c); }
+  void put(const char *str) { buf.insert(buf.end(), str, str + strlen(str)); }
+  void put(const string &str) { buf.insert(buf.end(), str.begin(), str.end()); }
+
+  void put_int(long val)
+  {
+    char digits[24];
+    char *p = digits + sizeof(digits);
+    unsigned long uval = (val < 0) ? -(unsigned long)val : val;
+    do {
+      *--p = '0' + uval % 10;
+      uval /= 10;
+    } while (uval);
+    if (val < 0)
+      *--p = '-';
+    buf.insert(buf.end(), p, digits + sizeof(digits));
+  }
+
+  // Same format as Vec3d::to_str()
+  void put_double(double val, int sig_dgts)
+  {
+    const size_t sz = buf.size();
+    const size_t max_len = 32;
+    buf.resize(sz + max_len);
+    const char *fmt = (sig_dgts > 0) ? "%.*g" : "%.*f";
+    const int prec = (sig_dgts > 0) ? sig_dgts : -sig_dgts;
+    int len = snprintf(&buf[sz], max_len, fmt, prec, val);
+    if (len >= (int)max_len) { // very large number in fixed format
+      buf.resize(sz + len + 1);
+      snprintf(&buf[sz], len + 1, fmt, prec, val);
+    }
+    buf.resize(sz + len);
+  }
+
+  void put_vec(const Vec3d &v, const char *sep, int sig_dgts)
+  {
+    if (!v.is_set()) {
+      put("not set");
+      return;
+    }
+    for (int i = 0; i < 3; i++) {
+      if (i)
+        put(sep);
+      put_double(v[i], sig_dgts);
+    }
+  }
+
+  // Same format as off_col()
+  void put_col(const Color &col)
+  {
+    uint64_t key;
+    if (col.is_index())
+      key = ((uint64_t)(unsigned int)col.get_index() << 2) | 1;
+    else if (col.is_value())
+      key = ((uint64_t)col[0] << 26 | (uint64_t)col[1] << 18 |
+             (uint64_t)col[2] << 10 | (uint64_t)col[3] << 2) |
+            2;
+    else
+      return; // unset
+    auto it = col_strs.find(key);
+    if (it == col_strs.end())
+      it = col_strs.emplace(key, off_col(col)).first;
+    put(it->second);
+  }
+};
+
+// Format a range of numbered items in parallel, each thread formatting
+// into its own buffer, and write the buffers in order.
+void parallel_write(FILE *ofile, int num,
+                    const std::function<void(TextBuffer &, int)> &format_item)
+{
+  const int min_blk_items = 1 << 12;
+  const int max_blk_items = 1 << 16;
+  const int num_threads = get_num_threads();
+  vector<TextBuffer> bufs(parallel_blocks(
+      (num + min_blk_items - 1) / min_blk_items, num_threads, 1));
+  const int round_items = bufs.size() * max_blk_items;
+  for (int round_start = 0; round_start < num; round_start += round_items) {
+    const int round_num = std::min(num - round_start, round_items);
+    parallel_for(
+        round_num,
+        [&](int start, int end, int blk) {
+          TextBuffer &buf = bufs[blk];
+          buf.clear();
+          for (int i = start; i < end; i++)
+            format_item(buf, round_start + i);
+        },
+        bufs.size(), 1);
+    for (int i = 0; i < parallel_blocks(round_num, bufs.size(), 1); i++)
+      bufs[i].write(ofile);
+  }
+}
+
+} // namespace
+
+void crds_write(FILE *ofile, const Geometry &geom, const char *sep,
+                int sig_dgts)
+{
+  const auto &verts = geom.verts();
+  parallel_write(ofile, verts.size(), [&](TextBuffer &buf, int i) {
+    buf.put_vec(verts[i], sep, sig_dgts);
+    buf.put('\n');
+  });
+}
+
+Status crds_write(string file_name, const Geometry &geom, const char *sep,
+                  int sig_dgts)
+{
+  string error_msg;
+  FILE *ofile = file_open_w(file_name, error_msg);
+  if (!ofile)
+    return Status::error(error_msg);
+
+  crds_write(ofile, geom, sep, sig_dgts);
+  file_close_w(ofile);
+  return Status::ok();
+}
+
 void write_mtl_color(FILE *mfile, Color c)
 {
   fprintf(mfile, "newmtl color_%02x%02x%02x%02x\n", c[0], c[1], c[2], c[3]);
@@ -173,7 +288,7 @@ void obj_write(FILE *ofile, FILE *mfile, string mtl_file, const Geometry &geom,
     fprintf(ofile, "mtllib %s\n", mtl_file.c_str());
 
   // v entries
-  for (unsigned int i = 0; i < geom.verts().size(); i++) {
+  parallel_write(ofile, geom.verts().size(), [&](TextBuffer &buf, int i) {
     Color c = geom.colors(VERTS).get(i);
     // only color values can be used
     if (!c.is_value())
@@ -181,61 +296,76 @@ void obj_write(FILE *ofile, FILE *mfile, string mtl_file, const Geometry &geom,
     else if (!c.is_invisible()) {
       c.set_alpha(255); // future transparency possible?
     }
-    fprintf(ofile, "v %s %s\n", geom.verts(i).to_str(sep, sig_dgts).c_str(),
-            off_col(c).c_str());
-  }
+    buf.put("v ");
+    buf.put_vec(geom.verts(i), sep, sig_dgts);
+    buf.put(' ');
+    buf.put_col(c);
+    buf.put('\n');
+  });
+
+  // face colour for materials
+  auto mtl_col = [&](int i) {
+    Color c = geom.colors(FACES).get(i);
+    if (c.is_value() && !c.is_invisible())
+      c.set_alpha(255); // future transparency possible?
+    return c;
+  };
 
-  Color last_color = Color();
+  if (mfile) {
+    for (unsigned int i = 0; i < geom.faces().size(); i++) {
+      Color c = mtl_col(i);
+      if (c.is_value() && !c.is_invisible())
+        cols.push_back(c);
+    }
+  }
 
   // f entries
-  for (unsigned int i = 0; i < geom.faces().size(); i++) {
+  parallel_write(ofile, geom.faces().size(), [&](TextBuffer &buf, int i) {
     // if materials, color logic
     if (mfile) {
-      Color c = geom.colors(FACES).get(i);
-      if (c.is_value() && !c.is_invisible()) {
-        c.set_alpha(255); // future transparency possible?
-        cols.push_back(c);
-      }
+      Color c = mtl_col(i);
       // first color might be unset
-      if (c != last_color || i == 0) {
+      if (i == 0 || c != mtl_col(i - 1)) {
         if (c.is_value() && !c.is_invisible())
-          fprintf(ofile, "usemtl color_%02x%02x%02x%02x\n", c[0], c[1], c[2],
-                  c[3]);
+          buf.put(msg_str("usemtl color_%02x%02x%02x%02x\n", c[0], c[1], c[2],
+                          c[3]));
         else
-          fprintf(ofile, "usemtl color_face_default\n");
+          buf.put("usemtl color_face_default\n");
       }
-      last_color = c;
     }
-    fprintf(ofile, "f");
-    for (unsigned int j = 0; j < geom.faces(i).size(); j++)
-      fprintf(ofile, " %d", geom.faces(i, j) + offset);
-    fprintf(ofile, "\n");
-  }
-
-  last_color = Color();
+    buf.put('f');
+    for (int idx : geom.faces(i)) {
+      buf.put(' ');
+      buf.put_int(idx + offset);
+    }
+    buf.put('\n');
+  });
 
   // l entries
-  for (unsigned int i = 0; i < geom.edges().size(); i++) {
-    /* edges cannot currently have colors
-        // if materials, color logic
-        if (mfile) {
-          Color c = geom.colors(EDGES).get(i);
-          if (c.is_value() && !c.is_invisible()) {
-            c.set_alpha(255); // future transparency possible?
-            cols.push_back(c);
-          }
-          // first color might be unset
-          if (c != last_color || i == 0) {
-            if (c.is_value() && !c.is_invisible())
-              fprintf(ofile, "usemtl color_%02x%02x%02x%02x\n", c[0], c[1],
-       c[2], c[3]); else fprintf(ofile, "usemtl color_edge_default\n");
-          }
-          last_color = c;
+  /* edges cannot currently have colors
+      // if materials, color logic
+      if (mfile) {
+        Color c = geom.colors(EDGES).get(i);
+        if (c.is_value() && !c.is_invisible()) {
+          c.set_alpha(255); // future transparency possible?
+          cols.push_back(c);
         }
-    */
-    fprintf(ofile, "l %d %d\n", geom.edges(i, 0) + offset,
-            geom.edges(i, 1) + offset);
-  }
+        // first color might be unset
+        if (c != last_color || i == 0) {
+          if (c.is_value() && !c.is_invisible())
+            fprintf(ofile, "usemtl color_%02x%02x%02x%02x\n", c[0], c[1],
+     c[2], c[3]); else fprintf(ofile, "usemtl color_edge_default\n");
+        }
+        last_color = c;
+      }
+  */
+  parallel_write(ofile, geom.edges().size(), [&](TextBuffer &buf, int i) {
+    buf.put("l ");
+    buf.put_int(geom.edges(i, 0) + offset);
+    buf.put(' ');
+    buf.put_int(geom.edges(i, 1) + offset);
+    buf.put('\n');
+  });
 
   if (mfile)
     write_mtl_file(mfile, cols);
@@ -286,28 +416,38 @@ Status off_file_write(string file_name, const vector<const Geometry *> &geoms,
 
 void off_polys_write(FILE *ofile, const Geometry &geom, int offset)
 {
-  for (unsigned int i = 0; i < geom.faces().size(); i++) {
-    fprintf(ofile, "%lu", (unsigned long)geom.faces(i).size());
-    for (unsigned int j = 0; j < geom.faces(i).size(); j++) {
-      fprintf(ofile, " %d", geom.faces(i, j) + offset);
+  parallel_write(ofile, geom.faces().size(), [&](TextBuffer &buf, int i) {
+    const auto &face = geom.faces(i);
+    buf.put_int(face.size());
+    for (int idx : face) {
+      buf.put(' ');
+      buf.put_int(idx + offset);
     }
-    fprintf(ofile, " %s", off_col(geom.colors(FACES).get(i)).c_str());
-    fprintf(ofile, "\n");
-  }
+    buf.put(' ');
+    buf.put_col(geom.colors(FACES).get(i));
+    buf.put('\n');
+  });
+
+  parallel_write(ofile, geom.edges().size(), [&](TextBuffer &buf, int i) {
+    buf.put("2 ");
+    buf.put_int(geom.edges(i, 0) + offset);
+    buf.put(' ');
+    buf.put_int(geom.edges(i, 1) + offset);
+    buf.put(' ');
+    buf.put_col(geom.colors(EDGES).get(i));
+    buf.put('\n');
+  });
 
-  for (unsigned int i = 0; i < geom.edges().size(); i++) {
-    fprintf(ofile, "2 %d %d", geom.edges(i, 0) + offset,
-            geom.edges(i, 1) + offset);
-    fprintf(ofile, " %s", off_col(geom.colors(EDGES).get(i)).c_str());
-    fprintf(ofile, "\n");
-  }
   // print coloured vertex elements
-  map<int, Color>::const_iterator mi;
-  for (mi = geom.colors(VERTS).get_properties().begin();
-       mi != geom.colors(VERTS).get_properties().end(); mi++) {
-    fprintf(ofile, "1 %d %s\n", (mi->first) + offset,
-            off_col(mi->second).c_str());
-  }
+  TextBuffer buf;
+  geom.colors(VERTS).for_each([&](int idx, const Color &col) {
+    buf.put("1 ");
+    buf.put_int(idx + offset);
+    buf.put(' ');
+    buf.put_col(col);
+    buf.put('\n');
+  });
+  buf.write(ofile);
 }
 
 void off_file_write(FILE *ofile, const vector<const Geometry *> &geoms,
@@ -315,7 +455,7 @@ void off_file_write(FILE *ofile, const vector<const Geometry *> &geoms,
 {
   int vert_cnt = 0, face_cnt = 0, edge_cnt = 0;
   for (auto geom : geoms) {
-    int num_v_col_elems = geom->colors(VERTS).get_properties().size();
+    int num_v_col_elems = geom->colors(VERTS).size();
     vert_cnt += geom->verts().size();
     edge_cnt += geom->edges().size();
     face_cnt += geom->faces().size() + num_v_col_elems + edge_cnt;
@@ -342,3 +482,159 @@ void off_file_write(FILE *ofile, const Geometry &geom, int sig_dgts)
   vg.push_back(&geom);
   off_file_write(ofile, vg, sig_dgts);
 }
+
+// don't export these functions
+namespace {
+
+// Buffer values in little-endian order, and write them in blocks
+class LittleEndianWriter {
+private:
+  FILE *ofile;
+  vector<char> buf;
+  bool write_ok = true;
+  static const size_t blk_sz = 1 << 20;
+
+public:
+  LittleEndianWriter(FILE *ofile) : ofile(ofile) { buf.reserve(blk_sz); }
+  ~LittleEndianWriter() { flush(); }
+
+  template <typename T> void put(T val)
+  {
+    char bytes[sizeof(T)];
+    memcpy(bytes, &val, sizeof(T));
+    if (!host_is_little_endian())
+      std::reverse(bytes, bytes + sizeof(T));
+    buf.insert(buf.end(), bytes, bytes + sizeof(T));
+    if (buf.size() >= blk_sz)
+      flush();
+  }
+
+  void flush()
+  {
+    if (write_ok && fwrite(buf.data(), 1, buf.size(), ofile) != buf.size())
+      write_ok = false;
+    buf.clear();
+  }
+
+  // flush the buffer, and report whether all the data was written
+  bool is_ok()
+  {
+    flush();
+    return write_ok;
+  }
+};
+
+void bin_col_write(LittleEndianWriter &out, const Color &col)
+{
+  if (col.is_index())
+    out.put<int32_t>(col.get_index());
+  else
+    out.put<int32_t>(col.is_value() ? -1 : -2);
+  for (int i = 0; i < 4; i++)
+    out.put<unsigned char>(col.is_value() ? col[i] : 0);
+}
+
+void bin_cols_write(LittleEndianWriter &out,
+                    const vector<const Geometry *> &geoms, int type)
+{
+  for (auto geom : geoms) {
+    int num_elems = (type == VERTS)   ? geom->verts().size()
+                    : (type == EDGES) ? geom->edges().size()
+                                      : geom->faces().size();
+    for (int i = 0; i < num_elems; i++)
+      bin_col_write(out, geom->colors(type).get(i));
+  }
+}
+
+} // namespace
+
+Status off_bin_file_write(string file_name, const Geometry &geom)
+{
+  string error_msg;
+  FILE *ofile = file_open_w(file_name, error_msg, "wb");
+  if (!ofile)
+    return Status::error(error_msg);
+
+  Status stat = off_bin_file_write(ofile, geom);
+  file_close_w(ofile);
+  return stat;
+}
+
+Status off_bin_file_write(FILE *ofile, const vector<const Geometry *> &geoms)
+{
+  uint64_t vert_cnt = 0, face_cnt = 0, face_idx_cnt = 0, edge_cnt = 0;
+  unsigned int flags = 0;
+  for (auto geom : geoms) {
+    vert_cnt += geom->verts().size();
+    face_cnt += geom->faces().size();
+    edge_cnt += geom->edges().size();
+    for (const auto &face : geom->faces())
+      face_idx_cnt += face.size();
+    if (geom->colors(VERTS).size())
+      flags |= off_bin_vert_cols;
+    if (geom->colors(EDGES).size())
+      flags |= off_bin_edge_cols;
+    if (geom->colors(FACES).size())
+      flags |= off_bin_face_cols;
+  }
+
+  LittleEndianWriter out(ofile);
+  for (unsigned int i = 0; i < off_bin_magic_len; i++)
+    out.put<char>(off_bin_magic[i]);
+  out.put<uint32_t>(off_bin_version);
+  out.put<uint32_t>(flags);
+  out.put<uint64_t>(vert_cnt);
+  out.put<uint64_t>(face_cnt);
+  out.put<uint64_t>(face_idx_cnt);
+  out.put<uint64_t>(edge_cnt);
+
+  for (auto geom : geoms)
+    for (const auto &v : geom->verts())
+      for (int i = 0; i < 3; i++)
+        out.put<double>(v[i]);
+
+  uint64_t face_off = 0;
+  out.put<uint64_t>(face_off);
+  for (auto geom : geoms)
+    for (const auto &face : geom->faces())
+      out.put<uint64_t>(face_off += face.size());
+
+  // vertex index offsets, as for text OFF
+  vector<int> offsets;
+  int last_offset = 0;
+  vert_cnt = 0;
+  for (auto geom : geoms) {
+    offsets.push_back(geom->verts().size() ? vert_cnt : last_offset);
+    last_offset = vert_cnt;
+    vert_cnt += geom->verts().size();
+  }
+
+  for (unsigned int g = 0; g < geoms.size(); g++)
+    for (const auto &face : geoms[g]->faces())
+      for (int idx : face)
+        out.put<int32_t>(idx + offsets[g]);
+
+  for (unsigned int g = 0; g < geoms.size(); g++)
+    for (const auto &edge : geoms[g]->edges()) {
+      out.put<int32_t>(edge[0] + offsets[g]);
+      out.put<int32_t>(edge[1] + offsets[g]);
+    }
+
+  if (flags & off_bin_vert_cols)
+    bin_cols_write(out, geoms, VERTS);
+  if (flags & off_bin_edge_cols)
+    bin_cols_write(out, geoms, EDGES);
+  if (flags & off_bin_face_cols)
+    bin_cols_write(out, geoms, FACES);
+
+  if (!out.is_ok())
+    return Status::error("binary OFF: could not write all the data");
+  return Status::ok();
+}
+
+Status off_bin_file_write(FILE *ofile, const Geometry &geom)
+{
+  vector<const Geometry *> vg;
+  vg.push_back(&geom);
+  return off_bin_file_write(ofile, vg);
+}
@@ -29,12 +29,17 @@
 */
 
 #include "planar.h"
+#include "boundbox.h"
 
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <map>
+#include <numeric>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 using std::make_pair;
@@ -82,13 +87,24 @@ void project_using_normal(const Vec3d &normal, int &idx, int &sign)
 // put faces numbers in face_idxs into fgeom
 Geometry faces_to_geom(const Geometry &geom, const vector<int> &face_idxs)
 {
+  // copy only the vertices used by the faces, keeping their order
+  vector<int> v_idxs;
+  for (int j : face_idxs)
+    v_idxs.insert(v_idxs.end(), geom.faces()[j].begin(),
+                  geom.faces()[j].end());
+  sort(v_idxs.begin(), v_idxs.end());
+  v_idxs.erase(unique(v_idxs.begin(), v_idxs.end()), v_idxs.end());
+
   Geometry fgeom;
-  fgeom.add_verts(geom.verts());
-  fgeom.colors(VERTS) = geom.colors(VERTS);
+  for (int v_idx : v_idxs)
+    fgeom.add_vert(geom.verts()[v_idx], geom.colors(VERTS).get(v_idx));
+
   for (int j : face_idxs) {
-    fgeom.add_face(geom.faces()[j], geom.colors(FACES).get(j));
+    vector<int> face = geom.faces()[j];
+    for (int &v_idx : face)
+      v_idx = lower_bound(v_idxs.begin(), v_idxs.end(), v_idx) - v_idxs.begin();
+    fgeom.add_face(face, geom.colors(FACES).get(j));
   }
-  fgeom.del(VERTS, fgeom.get_info().get_free_verts());
   return fgeom;
 }
 
@@ -106,6 +122,18 @@ int vertex_into_geom(Geometry &geom, const Vec3d &P, Color vcol,
   return v_idx;
 }
 
+int vertex_into_geom(Geometry &geom, PointIndex &vert_index, const Vec3d &P,
+                     Color vcol, const double eps)
+{
+  int v_idx = vert_index.find_coincident(P, eps);
+  if (v_idx == -1) {
+    geom.add_vert(P, vcol);
+    v_idx = vert_index.add(P);
+  }
+
+  return v_idx;
+}
+
 // if edge already exists, do not create another one and return false. return
 // true if new edge created
 // check if edge1 and edge2 indexes are equal. If so do not allow an edge length
@@ -126,6 +154,22 @@ bool edge_into_geom(Geometry &geom, const int v_idx1, const int v_idx2,
   return ((answer < 0) ? true : false);
 }
 
+// don't export these functions
+namespace {
+
+// connections from every vertex, in the order find_connections() gives
+void find_all_connections(const Geometry &geom, vector<vector<int>> &cons)
+{
+  cons.assign(geom.verts().size(), vector<int>());
+  for (const auto &edge : geom.edges()) {
+    cons[edge[0]].push_back(edge[1]);
+    if (edge[1] != edge[0])
+      cons[edge[1]].push_back(edge[0]);
+  }
+}
+
+} // namespace
+
 // input seperate networks of overlapping edges and merge them into one network
 bool mesh_edges(Geometry &geom, const double eps)
 {
@@ -143,25 +187,70 @@ bool mesh_edges(Geometry &geom, const double eps)
   unsigned int vsz = verts.size();
   unsigned int esz = edges.size();
 
+  // Vertices and edges are looked up by hash rather than by searching the
+  // geometry, with the same results as vertex_into_geom and edge_into_geom
+  PointIndex vert_index(geom.verts(), 4 * eps);
+  auto add_edgelet = [&](int v_idx1, int v_idx2) {
+    if (v_idx1 != v_idx2 && geom.find_edge(v_idx1, v_idx2) < 0)
+      geom.add_edge(make_edge(v_idx1, v_idx2), Color::invisible);
+  };
+
+  // An intersection point lies on both edges, so only edges with
+  // overlapping ranges along an axis are compared. The axis is the one
+  // along which the vertices are most spread out, so a diagram in a
+  // coordinate plane is still separated.
+  BoundBox bb(verts);
+  const Vec3d extent = bb.get_max() - bb.get_min();
+  int axis = 0;
+  for (int i = 1; i < 3; i++)
+    if (extent[i] > extent[axis])
+      axis = i;
+
+  // Sweep the edges in order of the start of their range, keeping the
+  // edges whose range has not ended, and pair each edge with these.
+  vector<double> r_min(esz), r_max(esz);
+  for (unsigned int i = 0; i < esz; i++) {
+    r_min[i] = std::min(verts[edges[i][0]][axis], verts[edges[i][1]][axis]);
+    r_max[i] = std::max(verts[edges[i][0]][axis], verts[edges[i][1]][axis]);
+  }
+  vector<int> r_order(esz);
+  std::iota(r_order.begin(), r_order.end(), 0);
+  std::stable_sort(r_order.begin(), r_order.end(),
+                   [&](int e0, int e1) { return r_min[e0] < r_min[e1]; });
+  const double r_margin = 4 * eps; // more than the 2*eps that is needed
+
+  // edges that may intersect each edge
+  vector<vector<int>> cands(esz);
+  vector<int> active;
+  for (int j : r_order) {
+    unsigned int num_active = 0;
+    for (int i : active) {
+      if (r_max[i] + r_margin < r_min[j])
+        continue; // ended, and all later edges start after r_min[j]
+      active[num_active++] = i;
+      cands[i].push_back(j);
+      cands[j].push_back(i);
+    }
+    active.resize(num_active);
+    active.push_back(j);
+  }
+
   vector<int> deleted_edges;
-  vector<pair<pair<int, int>, int>> new_verts;
+  // vertex created for the intersection of edges i,j, keyed by j,i
+  std::unordered_map<long long, int> new_verts;
 
   // compare only existing edges
   for (unsigned int i = 0; i < esz; i++) {
-    vector<pair<double, int>> line_intersections;
-    for (unsigned int j = 0; j < esz; j++) {
-      // don't compare to self
-      if (i == j)
-        continue;
+    // edges that may intersect, in index order
+    sort(cands[i].begin(), cands[i].end());
 
+    vector<pair<double, int>> line_intersections;
+    for (int j : cands[i]) {
       // see if the new vertex was already created
       int v_idx = -1;
-      for (auto &new_vert : new_verts) {
-        if (new_vert.first.first == (int)i && new_vert.first.second == (int)j) {
-          v_idx = new_vert.second;
-          break;
-        }
-      }
+      const auto new_vert = new_verts.find(((long long)i << 32) | j);
+      if (new_vert != new_verts.end())
+        v_idx = new_vert->second;
 
       // if it doesn't already exist, see if it needs to be created
       if (v_idx == -1) {
@@ -171,19 +260,15 @@ bool mesh_edges(Geometry &geom, const double eps)
                                   verts[edges[j][0]], verts[edges[j][1]], eps);
         if (intersection_point.is_set()) {
           // find (or create) index of this vertex
-          v_idx =
-              vertex_into_geom(geom, intersection_point, Color::invisible, eps);
+          v_idx = vertex_into_geom(geom, vert_index, intersection_point,
+                                   Color::invisible, eps);
           // don't include existing vertices
           if (v_idx < (int)vsz)
             v_idx = -1;
           else {
             // store index of vert at i,j. Reverse index i,j so it will be found
             // when encountering edges j,i
-            pair<pair<int, int>, int> new_vert;
-            new_vert.first.first = j;
-            new_vert.first.second = i;
-            new_vert.second = v_idx;
-            new_verts.push_back(new_vert);
+            new_verts[((long long)j << 32) | i] = v_idx;
           }
         }
       }
@@ -203,14 +288,12 @@ bool mesh_edges(Geometry &geom, const double eps)
       sort(line_intersections.begin(), line_intersections.end());
       // create edgelets from P0 through intersection points to P1 (using
       // indexes)
-      edge_into_geom(geom, edges[i][0], line_intersections[0].second,
-                     Color::invisible);
+      add_edgelet(edges[i][0], line_intersections[0].second);
       for (unsigned int k = 0; k < line_intersections.size() - 1; k++)
-        edge_into_geom(geom, line_intersections[k].second,
-                       line_intersections[k + 1].second, Color::invisible);
-      edge_into_geom(geom,
-                     line_intersections[line_intersections.size() - 1].second,
-                     edges[i][1], Color::invisible);
+        add_edgelet(line_intersections[k].second,
+                    line_intersections[k + 1].second);
+      add_edgelet(line_intersections[line_intersections.size() - 1].second,
+                  edges[i][1]);
     }
   }
 
@@ -237,10 +320,10 @@ void build_angle_map(const Geometry &geom,
   int idx0 = (idx + 1) % 3;
   int idx1 = (idx + 2) % 3;
 
+  vector<vector<int>> cons;
+  find_all_connections(geom, cons);
   for (unsigned int i = 0; i < verts.size(); i++) {
-    vector<int> vcons;
-    find_connections(geom, vcons, i);
-    for (int k : vcons) {
+    for (int k : cons[i]) {
       double y = verts[k][idx1] - verts[i][idx1];
       double x = verts[k][idx0] - verts[i][idx0];
       double angle = rad2deg(atan2(y, x));
@@ -259,15 +342,16 @@ void build_turn_map(const Geometry &geom, map<pair<int, int>, int> &turn_map,
                     map<pair<int, int>, double> &angle_map)
 {
   const vector<vector<int>> &edges = geom.edges();
+  vector<vector<int>> cons;
+  find_all_connections(geom, cons);
 
   for (const auto &edge : edges) {
     for (unsigned int j = 0; j < 2; j++) {
-      vector<int> vcons;
       int a = edge[!j ? 0 : 1];
       int b = edge[!j ? 1 : 0];
 
       double base_angle = angle_map[make_pair(b, a)];
-      find_connections(geom, vcons, b);
+      const vector<int> &vcons = cons[b];
       vector<pair<double, int>> angles;
       for (unsigned int k = 0; k < vcons.size(); k++) {
         int c = vcons[k];
@@ -583,9 +667,10 @@ Geometry make_stellation_diagram(Geometry &geom, int f_idx, string sym_string,
 
   // trim off edges with only one connection
   vector<int> del_verts;
+  vector<vector<int>> cons;
+  find_all_connections(diagram, cons);
   for (unsigned int i = 0; i < diagram.verts().size(); i++) {
-    vector<int> edge_idx = find_edges_with_vertex(diagram.edges(), i);
-    if (edge_idx.size() == 1)
+    if (cons[i].size() == 1)
       del_verts.push_back(i);
   }
   if (del_verts.size())
@@ -604,7 +689,7 @@ Geometry make_stellation_diagram(Geometry &geom, int f_idx, string sym_string,
 
 void split_pinched_faces(Geometry &geom, double eps)
 {
-  vector<vector<int>> &faces = geom.raw_faces();
+  const vector<vector<int>> &faces = geom.faces();
 
   // have to keep looping in case faces pinched more than once
   bool found;
@@ -34,6 +34,7 @@
 #include "geometry.h"
 #include "geometryinfo.h"
 #include "geometryutils.h"
+#include "pointindex.h"
 #include "vec3d.h"
 
 using std::map;
@@ -59,6 +60,19 @@ Geometry faces_to_geom(const Geometry &geom, const std::vector<int> &face_idxs);
 int vertex_into_geom(Geometry &geom, const Vec3d &P, Color vcol,
                      const double eps);
 
+/// add a vector P into the geom unless a point already occupies that point
+/** The point is looked up in an index of the vertices, which is much
+ *  quicker than vertex_into_geom() without an index when adding many points.
+ * \param geom the geometry.
+ * \param vert_index an index of the vertices of geom, in the same order. A
+ *  new point is also added to it.
+ * \param P a point.
+ * \param vcol color of the new point.
+ * \param eps value for contolling the limit of precision.
+ * \return the index of the new point, or the occupying point. */
+int vertex_into_geom(Geometry &geom, PointIndex &vert_index, const Vec3d &P,
+                     Color vcol, const double eps);
+
 /// add an edge v1, v2 into the geom unless an edge of v1, v2 already exists
 /**\param geom the geometry.
  * \param v_idx1 is the first index.
@@ -0,0 +1,263 @@
+/*
+   Copyright (c) 2026, Adrian Rossiter
+
+   Antiprism - http://www.antiprism.com
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+      The above copyright notice and this permission notice shall be included
+      in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+/* \file pointindex.cc
+   \brief Spatial index of points
+*/
+
+#include "pointindex.h"
+#include "boundbox.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+using std::vector;
+
+namespace anti {
+
+// don't export these functions
+namespace {
+
+bool is_finite(const Vec3d &v)
+{
+  return std::isfinite(v[0]) && std::isfinite(v[1]) && std::isfinite(v[2]);
+}
+
+} // namespace
+
+PointIndex::PointIndex(double cell_size)
+    : cell_size((cell_size > 0.0) ? cell_size : 1.0)
+{
+}
+
+PointIndex::PointIndex(const vector<Vec3d> &pts, double cell_size)
+    : cell_size(cell_size)
+{
+  if (!(cell_size > 0.0)) {
+    vector<Vec3d> finite_pts;
+    for (const auto &P : pts)
+      if (is_finite(P))
+        finite_pts.push_back(P);
+    BoundBox bb(finite_pts);
+    const double ext = finite_pts.size()
+                           ? (bb.get_max() - bb.get_min()).len() / sqrt(3.0)
+                           : 0.0;
+    // about one point per cell if the points fill the box
+    this->cell_size = (ext > 0.0) ? ext / cbrt((double)finite_pts.size()) : 1.0;
+  }
+
+  points.reserve(pts.size());
+  cells.reserve(pts.size());
+  for (const auto &P : pts)
+    add(P);
+}
+
+long long PointIndex::get_cell_idx(double coord) const
+{
+  const double lim = 1e18; // keep the cell index in range
+  return (long long)std::max(-lim, std::min(lim, floor(coord / cell_size)));
+}
+
+PointIndex::Cell PointIndex::get_cell(const Vec3d &P) const
+{
+  return {get_cell_idx(P[0]), get_cell_idx(P[1]), get_cell_idx(P[2])};
+}
+
+int PointIndex::add(const Vec3d &P)
+{
+  const int idx = points.size();
+  points.push_back(P);
+  if (is_finite(P))
+    cells[get_cell(P)].push_back(idx);
+  else if (!P.is_set())
+    unset_idxs.push_back(idx);
+  return idx;
+}
+
+void PointIndex::get_box_cells(const Vec3d &lo, const Vec3d &hi,
+                               vector<const vector<int> *> &cell_idxs) const
+{
+  cell_idxs.clear();
+  if (!is_finite(lo) || !is_finite(hi))
+    return;
+
+  const Cell c_lo = get_cell(lo);
+  const Cell c_hi = get_cell(hi);
+  const double num_box_cells = (double)(c_hi.x - c_lo.x + 1) *
+                               (double)(c_hi.y - c_lo.y + 1) *
+                               (double)(c_hi.z - c_lo.z + 1);
+
+  // a box with more cells than are stored is checked against every cell
+  if (num_box_cells > cells.size()) {
+    for (const auto &cell : cells) {
+      const Cell &c = cell.first;
+      if (c.x >= c_lo.x && c.x <= c_hi.x && c.y >= c_lo.y && c.y <= c_hi.y &&
+          c.z >= c_lo.z && c.z <= c_hi.z)
+        cell_idxs.push_back(&cell.second);
+    }
+    return;
+  }
+
+  for (long long x = c_lo.x; x <= c_hi.x; x++)
+    for (long long y = c_lo.y; y <= c_hi.y; y++)
+      for (long long z = c_lo.z; z <= c_hi.z; z++) {
+        const auto it = cells.find({x, y, z});
+        if (it != cells.end())
+          cell_idxs.push_back(&it->second);
+      }
+}
+
+void PointIndex::find_in_box(const Vec3d &lo, const Vec3d &hi,
+                             vector<int> &idxs) const
+{
+  idxs.clear();
+  vector<const vector<int> *> cell_idxs;
+  get_box_cells(lo, hi, cell_idxs);
+  for (const auto *cell : cell_idxs)
+    for (int idx : *cell) {
+      const Vec3d &Q = points[idx];
+      if (Q[0] >= lo[0] && Q[0] <= hi[0] && Q[1] >= lo[1] && Q[1] <= hi[1] &&
+          Q[2] >= lo[2] && Q[2] <= hi[2])
+        idxs.push_back(idx);
+    }
+  std::sort(idxs.begin(), idxs.end());
+}
+
+void PointIndex::find_in_radius(const Vec3d &P, double radius,
+                                vector<int> &idxs) const
+{
+  idxs.clear();
+  if (!(radius >= 0.0))
+    return;
+
+  const Vec3d half_diag(radius, radius, radius);
+  vector<const vector<int> *> cell_idxs;
+  get_box_cells(P - half_diag, P + half_diag, cell_idxs);
+  const double rad2 = radius * radius;
+  for (const auto *cell : cell_idxs)
+    for (int idx : *cell)
+      if ((points[idx] - P).len2() <= rad2)
+        idxs.push_back(idx);
+  std::sort(idxs.begin(), idxs.end());
+}
+
+void PointIndex::find_in_shell(const Vec3d &P, double len2, double eps,
+                               vector<int> &idxs) const
+{
+  idxs.clear();
+  if (!(len2 + eps > 0.0))
+    return;
+
+  // outer radius of the shell, with a margin for rounding
+  const double radius = sqrt(len2 + eps) * (1 + 1e-10);
+  const Vec3d half_diag(radius, radius, radius);
+  vector<const vector<int> *> cell_idxs;
+  get_box_cells(P - half_diag, P + half_diag, cell_idxs);
+  for (const auto *cell : cell_idxs)
+    for (int idx : *cell)
+      if (fabs((points[idx] - P).len2() - len2) < eps)
+        idxs.push_back(idx);
+  std::sort(idxs.begin(), idxs.end());
+}
+
+int PointIndex::find_nearest(const Vec3d &P) const
+{
+  if (!is_finite(P) || cells.empty())
+    return -1;
+
+  int found = -1;
+  double found_dist2 = 0.0;
+  auto test_cell = [&](const vector<int> &cell) {
+    for (int idx : cell) {
+      const double dist2 = (points[idx] - P).len2();
+      if (found == -1 || dist2 < found_dist2 ||
+          (dist2 == found_dist2 && idx < found)) {
+        found = idx;
+        found_dist2 = dist2;
+      }
+    }
+  };
+
+  // search rings of cells around the cell of P. A point in ring k+1 is at
+  // least k cells from P, so the search can stop when the nearest point
+  // found is closer than that
+  const Cell c = get_cell(P);
+  for (long long k = 0;; k++) {
+    const double ring_side = 2.0 * k + 1;
+    if (ring_side * ring_side * ring_side > cells.size()) {
+      // the rings have more cells than are stored, check every cell
+      for (const auto &cell : cells)
+        test_cell(cell.second);
+      break;
+    }
+
+    for (long long x = c.x - k; x <= c.x + k; x++)
+      for (long long y = c.y - k; y <= c.y + k; y++)
+        for (long long z = c.z - k; z <= c.z + k; z++) {
+          if (std::max(std::max(llabs(x - c.x), llabs(y - c.y)),
+                       llabs(z - c.z)) != k)
+            continue; // not in the ring
+          const auto it = cells.find({x, y, z});
+          if (it != cells.end())
+            test_cell(it->second);
+        }
+
+    const double ring_dist = k * cell_size;
+    if (found != -1 && found_dist2 < ring_dist * ring_dist)
+      break;
+  }
+
+  return found;
+}
+
+int PointIndex::find_coincident(const Vec3d &P, double eps, int after) const
+{
+  if (!P.is_set()) {
+    auto ui = std::upper_bound(unset_idxs.begin(), unset_idxs.end(), after);
+    return (ui != unset_idxs.end()) ? *ui : -1;
+  }
+
+  // visit the cells overlapped by a box around P, with a margin over eps
+  const Vec3d margin(2 * eps, 2 * eps, 2 * eps);
+  vector<const vector<int> *> cell_idxs;
+  get_box_cells(P - margin, P + margin, cell_idxs);
+
+  int found = -1;
+  for (const auto *cell : cell_idxs) {
+    auto ci = std::upper_bound(cell->begin(), cell->end(), after);
+    for (; ci != cell->end(); ++ci) {
+      if (found != -1 && *ci > found)
+        break;
+      if (!compare(points[*ci], P, eps)) {
+        found = *ci;
+        break;
+      }
+    }
+  }
+  return found;
+}
+
+} // namespace anti
@@ -0,0 +1,150 @@
+/*
+   Copyright (c) 2026, Adrian Rossiter
+
+   Antiprism - http://www.antiprism.com
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+      The above copyright notice and this permission notice shall be included
+      in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+/*!\file pointindex.h
+   \brief Spatial index of points
+*/
+
+#ifndef POINTINDEX_H
+#define POINTINDEX_H
+
+#include "vec3d.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace anti {
+
+/// Spatial index of points, for finding points by position
+/** The points are held in a grid of cubic cells, and only the cells that
+ *  contain points are stored. A query visits the cells that overlap its
+ *  region and tests the points in them, so it takes a time proportional to
+ *  the number of points found when the cells are about the size of the
+ *  region. Points are numbered in the order they are added. A point with a
+ *  coordinate that is not finite is numbered, but is only found when it is
+ *  unset and coincidence is tested. */
+class PointIndex {
+private:
+  struct Cell {
+    long long x, y, z;
+    bool operator==(const Cell &c) const
+    {
+      return x == c.x && y == c.y && z == c.z;
+    }
+  };
+
+  struct CellHash {
+    size_t operator()(const Cell &c) const
+    {
+      size_t h = std::hash<long long>()(c.x);
+      h = h * 1000003 ^ std::hash<long long>()(c.y);
+      return h * 1000003 ^ std::hash<long long>()(c.z);
+    }
+  };
+
+  double cell_size;
+  std::vector<Vec3d> points;
+  // point indexes in each cell, in increasing order
+  std::unordered_map<Cell, std::vector<int>, CellHash> cells;
+  // indexes of unset points, which compare() treats as coincident
+  std::vector<int> unset_idxs;
+
+  long long get_cell_idx(double coord) const;
+  Cell get_cell(const Vec3d &P) const;
+  void get_box_cells(const Vec3d &lo, const Vec3d &hi,
+                     std::vector<const std::vector<int> *> &cell_idxs) const;
+
+public:
+  /// Constructor
+  /**\param cell_size the side of a cell, if not positive \c 1 is used.
+   *  Queries are quickest when it is about the size of the query regions. */
+  PointIndex(double cell_size);
+
+  /// Constructor
+  /**\param points the points to index.
+   * \param cell_size the side of a cell, if not positive the size gives
+   *  about one point per cell in the bounding box of the points. */
+  PointIndex(const std::vector<Vec3d> &points, double cell_size = 0.0);
+
+  /// Add a point
+  /**\param P the point.
+   * \return The index of the point. */
+  int add(const Vec3d &P);
+
+  /// Get the number of points
+  /**\return The number of points. */
+  int size() const { return points.size(); }
+
+  /// Get a point
+  /**\param idx the index of the point.
+   * \return The point. */
+  const Vec3d &get_point(int idx) const { return points[idx]; }
+
+  /// Get the side of a cell
+  /**\return The side of a cell. */
+  double get_cell_size() const { return cell_size; }
+
+  /// Find the points in a box
+  /**\param lo the corner of the box with the lowest coordinates.
+   * \param hi the corner of the box with the highest coordinates.
+   * \param idxs the indexes of the points, in increasing order. */
+  void find_in_box(const Vec3d &lo, const Vec3d &hi,
+                   std::vector<int> &idxs) const;
+
+  /// Find the points within a distance of a point
+  /**\param P the point.
+   * \param radius the distance.
+   * \param idxs the indexes of the points \c Q with
+   *  <tt>(Q-P).len2() <= radius*radius</tt>, in increasing order. */
+  void find_in_radius(const Vec3d &P, double radius,
+                      std::vector<int> &idxs) const;
+
+  /// Find the points at a squared distance from a point
+  /**\param P the point.
+   * \param len2 the square of the distance.
+   * \param eps a small number, the limit of the difference from \a len2.
+   * \param idxs the indexes of the points \c Q with
+   *  <tt>fabs((Q-P).len2() - len2) < eps</tt>, in increasing order. */
+  void find_in_shell(const Vec3d &P, double len2, double eps,
+                     std::vector<int> &idxs) const;
+
+  /// Find the nearest point
+  /**\param P the point.
+   * \return The index of the nearest point, the lowest index if there is
+   *  more than one, or \c -1 if there is no point to find. */
+  int find_nearest(const Vec3d &P) const;
+
+  /// Find a coincident point
+  /**\param P the point.
+   * \param eps a small number, points are coincident if no coordinate
+   *  differs by eps, as for \c compare().
+   * \param after only points with a higher index than this are considered.
+   * \return The lowest index of a coincident point, or \c -1 if there is
+   *  none. */
+  int find_coincident(const Vec3d &P, double eps, int after = -1) const;
+};
+
+} // namespace anti
+
+#endif // POINTINDEX_H
@@ -831,7 +831,7 @@ Status Polygon::make_cupola_part(Geometry &geom)
 
   int v_sz = cup_geom.verts().size();
   add_polygon(cup_geom, ht);
-  auto &last_face = cup_geom.faces(cup_geom.faces().size() - 1);
+  auto &last_face = cup_geom.faces_mut(cup_geom.faces().size() - 1);
   std::reverse(last_face.begin(), last_face.end());
   for (int i = 0; i < 2 * num_sides; i++) {
     vector<int> face;
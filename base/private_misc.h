@@ -46,8 +46,10 @@ int triangulate(Geometry &geom, Color inv = Color(),
 void triangulate_basic(Geometry &geom, bool sq_diag = true, Color inv = Color(),
                        std::vector<int> *fmap = nullptr);
 
-Status add_hull(Geometry &geom, std::string qh_args = "", int *dim = nullptr);
-Status set_hull(Geometry &geom, std::string qh_args = "", int *dim = nullptr);
+Status add_hull(Geometry &geom, std::string qh_args = "", int *dim = nullptr,
+                bool prefilter = false);
+Status set_hull(Geometry &geom, std::string qh_args = "", int *dim = nullptr,
+                bool prefilter = false);
 
 /// Get Voronoi cells.
 /**Get all Voronoi cells of the vertex points which are finite polyhedra.
@@ -35,6 +35,31 @@
 
 using namespace anti;
 
+// Binary OFF format, all values little-endian
+//   header (48 bytes): signature (8 bytes), version (uint32),
+//     flags (uint32, off_bin_*_cols), counts (uint64) of vertices, faces,
+//     face indexes and edges
+//   vertex coordinates (3 x double per vertex)
+//   face offsets into the face indexes (uint64, number of faces + 1)
+//   face indexes (int32)
+//   edges (2 x int32 per edge)
+//   colour blocks for vertices, edges and faces, if set in the flags
+//     (int32 index, -1 for RGBA value, -2 for unset, then 4 bytes RGBA)
+
+// The signature cannot be the start of a text OFF or coordinates file
+const char off_bin_magic[] = "\x89OFF\r\n\x1a\n";
+const unsigned int off_bin_magic_len = 8;
+const unsigned int off_bin_version = 1;
+const unsigned int off_bin_header_sz = 48;
+const unsigned int off_bin_col_sz = 8;
+enum { off_bin_vert_cols = 1, off_bin_edge_cols = 2, off_bin_face_cols = 4 };
+
+inline bool host_is_little_endian()
+{
+  const unsigned int one = 1;
+  return *reinterpret_cast<const unsigned char *>(&one) == 1;
+}
+
 int read_off_line(FILE *fp, char **line);
 
 void crds_file_read(FILE *ifile, anti::Geometry &geom,
@@ -55,6 +80,8 @@ void obj_write(FILE *ofile, FILE *mfile, std::string mtl_file,
 anti::Status off_file_read(std::string file_name, anti::Geometry &geom);
 anti::Status off_file_read(FILE *ifile, anti::Geometry &geom);
 
+anti::Status off_bin_read(const char *data, size_t len, anti::Geometry &geom);
+
 anti::Status off_file_write(std::string file_name, const anti::Geometry &geom,
                             int sig_dgts = DEF_SIG_DGTS);
 void off_file_write(FILE *ofile, const anti::Geometry &geom,
@@ -67,4 +94,11 @@ void off_file_write(FILE *ofile,
                     const std::vector<const anti::Geometry *> &geoms,
                     int sig_dgts = DEF_SIG_DGTS);
 
+anti::Status off_bin_file_write(std::string file_name,
+                                const anti::Geometry &geom);
+anti::Status off_bin_file_write(FILE *ofile, const anti::Geometry &geom);
+anti::Status
+off_bin_file_write(FILE *ofile,
+                   const std::vector<const anti::Geometry *> &geoms);
+
 #endif // PRIVATE_OFF_FILE_H
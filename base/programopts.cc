@@ -41,10 +41,24 @@ using std::string;
 
 namespace anti {
 
-const char *ProgramOpts::help_ver_text =
+// don't export these
+namespace {
+const char *help_ver_no_bin_text =
     "  -h,--help this help message (run 'off_util -H help' for general help)\n"
     "  --version version information";
 
+const char *help_ver_bin_text =
+    "  -h,--help this help message (run 'off_util -H help' for general help)\n"
+    "  --version version information\n"
+    "  --binary  write OFF output in binary format (read automatically)";
+} // namespace
+
+ProgramOpts::ProgramOpts(string prog_name, bool off_output)
+    : program_name(prog_name), off_output(off_output),
+      help_ver_text(off_output ? help_ver_bin_text : help_ver_no_bin_text)
+{
+}
+
 const char *ProgramOpts::prog_name() const { return program_name.c_str(); }
 
 void ProgramOpts::message(string msg, const char *msg_type, string opt) const
@@ -121,7 +135,7 @@ bool ProgramOpts::common_opts(char c, char opt)
   return true;
 }
 
-void ProgramOpts::handle_long_opts(int argc, char *argv[])
+void ProgramOpts::handle_long_opts(int &argc, char *argv[])
 {
   for (int i = 1; i < argc; i++) {
     if (strcmp(argv[i], "--help") == 0) {
@@ -132,6 +146,14 @@ void ProgramOpts::handle_long_opts(int argc, char *argv[])
       version();
       exit(0);
     }
+    else if (off_output && strcmp(argv[i], "--binary") == 0) {
+      off_bin_output = true;
+      // remove the option, including the terminating null pointer
+      for (int j = i; j < argc; j++)
+        argv[j] = argv[j + 1];
+      argc--;
+      i--;
+    }
     else if (strncmp(argv[i], "--", 2) == 0 && strlen(argv[i]) > 2)
       error("unknown option", argv[i]);
   }
@@ -238,7 +260,8 @@ void ProgramOpts::read_or_error(Geometry &geom, const string &name)
 void ProgramOpts::write_or_error(const Geometry &geom, const string &name,
                                  int sig_dgts)
 {
-  print_status_or_exit(geom.write(name, sig_dgts));
+  print_status_or_exit(off_bin_output ? geom.write_bin(name)
+                                      : geom.write(name, sig_dgts));
   if (!geom.is_set())
     warning("output geometry has no vertices (empty geometry)");
 }
@@ -41,6 +41,8 @@ namespace anti {
 class ProgramOpts : public GetOpt {
 private:
   std::string program_name;
+  bool off_output;             // the program writes OFF output
+  bool off_bin_output = false; // write the OFF output in binary format
 
 public:
   enum {
@@ -50,11 +52,15 @@ public:
     argmatch_add_id_maps = 4
   };
 
-  static const char *help_ver_text;
+  /// Help text for the common long options
+  /** Includes \c --binary only if the program writes OFF output. */
+  const char *help_ver_text;
 
   /// Constructor
-  /**\param prog_name the name of the program. */
-  ProgramOpts(std::string prog_name) : program_name(prog_name) {}
+  /**\param prog_name the name of the program.
+   * \param off_output \c true if the program writes OFF output, which
+   *  may be written in binary format with \c --binary */
+  ProgramOpts(std::string prog_name, bool off_output = true);
 
   /// Destructor
   virtual ~ProgramOpts() = default;
@@ -131,9 +137,15 @@ public:
   void print_status_or_exit(const Status &stat, char opt) const;
 
   /// Process long options
-  /**\param argc the number of arguments.
+  /** Options that do not exit, like \c --binary, are removed from the
+   *  arguments.
+   * \param argc the number of arguments.
    * \param argv pointers to the argument strings. */
-  void handle_long_opts(int argc, char *argv[]);
+  void handle_long_opts(int &argc, char *argv[]);
+
+  /// Check whether OFF output should be written in binary format
+  /**\return \c true if \c --binary was given, otherwise \c false. */
+  bool get_off_bin_output() const { return off_bin_output; }
 
   /// Process common options
   /**\param c the character returned by getopt.
@@ -166,7 +178,8 @@ public:
 
   /// Write a geometry to a file name passed as a program argument
   /** Write geometry to a file name, print any messages, and error out
-   *  if necessary
+   *  if necessary. The geometry is written in binary OFF format if
+   *  \c --binary was given.
    * \param geom the model geometry
    * \param name file name or resource name of the model
    * \param sig_dgts the number of significant digits to write,
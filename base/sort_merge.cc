@@ -82,11 +82,6 @@ public:
   vertexMap(int o, int n) : old_vertex(o), new_vertex(n) {}
 };
 
-bool cmp_vertexMap(const vertexMap &a, const vertexMap &b)
-{
-  return a.old_vertex < b.old_vertex;
-}
-
 void remap_faces(vector<vector<int>> &faces, const vector<vertexMap> &vm)
 {
   for (auto &face : faces)
@@ -397,47 +392,43 @@ void sort_vertices(Geometry &geom, vector<vertexMap> &vm_all_verts,
   // the sort needs a consistent epsilon, not a variable
   stable_sort(vs.begin(), vs.end(), vert_cmp(1e-8));
 
+  const int num_verts = vs.size();
+
   // if not merging vertices, build map from old to new vertices for all
   // vertices
   if (!merge_verts) {
-    for (unsigned int i = 0; i < vs.size(); i++)
-      vm_all_verts.push_back(vertexMap(vs[i].vert_no, i));
-    stable_sort(vm_all_verts.begin(), vm_all_verts.end(), cmp_vertexMap);
+    vm_all_verts.assign(num_verts, vertexMap(0, 0));
+    for (int i = 0; i < num_verts; i++)
+      vm_all_verts[vs[i].vert_no] = vertexMap(vs[i].vert_no, i);
   }
 
   // if merging vertices, build map for merged vertices
   // mark coincident vertices for skipping if any
   // this is always done
-  if (true) {
-    int v = 0;
-    int cur_undeleted = 0; // the first face in a set of equivalent verts
-    unsigned int j = 0;
-    for (unsigned int i = 0; i < vs.size() - 1; i++) {
-      j = i + 1;
-
-      vm_merged_verts.push_back(vertexMap(vs[i].vert_no, v));
-
-      if (!compare(vs[i].vert, vs[j].vert, eps)) {
+  // the maps are filled by old vertex number, so they need no sorting
+  vm_merged_verts.assign(num_verts, vertexMap(0, 0));
+  int v = 0;
+  int cur_undeleted = 0; // the first vertex in a set of equivalent verts
+  for (int i = 0; i < num_verts; i++) {
+    if (i > 0) {
+      if (!compare(vs[i - 1].vert, vs[i].vert, eps)) {
         // don't set delete flag if we will not be using it
         if (merge_verts)
-          vs[j].deleted = true;
+          vs[i].deleted = true;
       }
       else {
         v++;
         if (include_colors)
           vs[cur_undeleted].average_col =
-              average_vert_color(vs, cur_undeleted, i, blend_type);
-        cur_undeleted = j;
+              average_vert_color(vs, cur_undeleted, i - 1, blend_type);
+        cur_undeleted = i;
       }
     }
-    if (include_colors)
-      vs[cur_undeleted].average_col =
-          average_vert_color(vs, cur_undeleted, j, blend_type);
-
-    vm_merged_verts.push_back(vertexMap(vs.back().vert_no, v));
-
-    stable_sort(vm_merged_verts.begin(), vm_merged_verts.end(), cmp_vertexMap);
+    vm_merged_verts[vs[i].vert_no] = vertexMap(vs[i].vert_no, v);
   }
+  if (include_colors)
+    vs[cur_undeleted].average_col =
+        average_vert_color(vs, cur_undeleted, num_verts - 1, blend_type);
 
   // the vertices to be written out have to be put into a second structure
   // so that no deleted vertices (if any) exist in the list
@@ -468,14 +459,11 @@ void sort_vertices(Geometry &geom, vector<vertexMap> &vm_all_verts,
       sort(vspm.begin(), vspm.end(), cmp_vert_no);
 
       // adjust the vertex maps
-      for (auto &vm_merged_vert : vm_merged_verts) {
-        for (unsigned j = 0; j < vspm.size(); j++) {
-          if (vspm[j].vert_new == vm_merged_vert.new_vertex) {
-            vm_merged_vert.new_vertex = j;
-            break;
-          }
-        }
-      }
+      vector<int> new_pos(vspm.size());
+      for (unsigned int j = 0; j < vspm.size(); j++)
+        new_pos[vspm[j].vert_new] = j;
+      for (auto &vm_merged_vert : vm_merged_verts)
+        vm_merged_vert.new_vertex = new_pos[vm_merged_vert.new_vertex];
 
       for (auto &vm_all_vert : vm_all_verts)
         vm_all_vert.new_vertex = vm_all_vert.old_vertex;
@@ -29,14 +29,19 @@
 #include "symmetry.h"
 #include "geometryinfo.h"
 #include "mathutils.h"
+#include "threads.h"
 #include "utils.h"
 
 #include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <map>
+#include <mutex>
 #include <numeric>
 #include <set>
+#include <unordered_map>
 
 using std::map;
 using std::pair;
@@ -50,26 +55,130 @@ namespace anti {
 const Vec3d A3(1, 1, 1); // 3-fold axis for T, O and I symmetry types
 const Vec3d A5(0, 1, (sqrt(5) + 1) / 2); // 5-fold axis for I symmetry type
 
+// don't export these functions
+namespace {
+
+// Index of transformations, for finding a transformation equal to a given
+// one, within sym_eps, in constant time. The matrix entries are quantised
+// to a grid much coarser than sym_eps, and an entry lying close to a grid
+// boundary is also looked up in the neighbouring bucket.
+class TransIndex {
+private:
+  std::vector<Trans3d> elems;
+  std::unordered_map<size_t, int> bucket_heads;
+  std::vector<int> bucket_next;
+
+  static constexpr double cell_size = 1e-3;
+
+  static size_t hash_cells(const long long *cells)
+  {
+    size_t h = 0;
+    for (int i = 0; i < 12; i++)
+      h = h * 1000003 ^ std::hash<long long>()(cells[i]);
+    return h;
+  }
+
+  // also returns the quantised entries of the transformation in cells
+  int find(const Trans3d &t, long long *cells) const
+  {
+    const double margin = 2 * sym_eps / cell_size;
+    long long alt_cells[12];
+    int near[12];
+    int num_near = 0;
+    for (int i = 0; i < 12; i++) {
+      const double q = t[i] / cell_size;
+      cells[i] = std::llround(q);
+      if (std::fabs(q - cells[i]) > 0.5 - margin) {
+        alt_cells[i] = cells[i] + ((q > cells[i]) ? 1 : -1);
+        near[num_near++] = i;
+      }
+    }
+
+    // try each combination of primary and neighbouring cells for the
+    // entries near a boundary (usually there are none)
+    long long probe[12];
+    for (int combo = 0; combo < (1 << num_near); combo++) {
+      std::copy(cells, cells + 12, probe);
+      for (int j = 0; j < num_near; j++)
+        if (combo & (1 << j))
+          probe[near[j]] = alt_cells[near[j]];
+      auto hi = bucket_heads.find(hash_cells(probe));
+      if (hi == bucket_heads.end())
+        continue;
+      for (int idx = hi->second; idx >= 0; idx = bucket_next[idx])
+        if (compare(elems[idx], t, sym_eps) == 0)
+          return idx;
+    }
+    return -1;
+  }
+
+public:
+  TransIndex() = default;
+
+  TransIndex(const Transformations &ts)
+  {
+    reserve(ts.size());
+    for (const auto &t : ts)
+      add(t);
+  }
+
+  size_t size() const { return elems.size(); }
+
+  const Trans3d &operator[](int idx) const { return elems[idx]; }
+
+  const std::vector<Trans3d> &get_elems() const { return elems; }
+
+  // index number of an equal transformation, or -1 if there is none
+  int find(const Trans3d &t) const
+  {
+    long long cells[12];
+    return find(t, cells);
+  }
+
+  // add a transformation if not already present, return its index number
+  int add(const Trans3d &t)
+  {
+    long long cells[12];
+    int idx = find(t, cells);
+    if (idx >= 0)
+      return idx;
+
+    idx = elems.size();
+    elems.push_back(t);
+    auto hi = bucket_heads.insert(std::make_pair(hash_cells(cells), -1)).first;
+    bucket_next.push_back(hi->second);
+    hi->second = idx;
+    return idx;
+  }
+
+  void reserve(size_t num)
+  {
+    elems.reserve(num);
+    bucket_heads.reserve(num);
+    bucket_next.reserve(num);
+  }
+};
+
+} // namespace
+
 Transformations &Transformations::product(const Transformations &s1,
                                           const Transformations &s2)
 {
+  // products are checked against the index rather than the set, and the
+  // first of any equal products is kept, as for set insertion
+  TransIndex prods;
+  prods.reserve(std::max(s1.size(), s2.size()));
+  for (const auto &t1 : s1.trans)
+    for (const auto &t2 : s2.trans)
+      prods.add(t1 * t2);
   clear();
-  set<Trans3d>::iterator i1, i2;
-  for (i1 = s1.trans.begin(); i1 != s1.trans.end(); i1++)
-    for (i2 = s2.trans.begin(); i2 != s2.trans.end(); i2++)
-      add((*i1) * (*i2));
+  trans.insert(prods.get_elems().begin(), prods.get_elems().end());
   return *this;
 }
 
 Transformations &Transformations::product_with(const Transformations &s)
 {
-  SymTransSet trans_orig = trans;
-  clear();
-  set<Trans3d>::iterator i0, i1;
-  for (i0 = trans_orig.begin(); i0 != trans_orig.end(); i0++)
-    for (i1 = s.trans.begin(); i1 != s.trans.end(); i1++)
-      add((*i0) * (*i1));
-  return *this;
+  return product(Transformations(*this), s);
 }
 
 Transformations &Transformations::conjugate(const Trans3d &t)
@@ -129,12 +238,19 @@ int Transformations::lcosets(Transformations sub,
                              vector<Transformations> &lcosets) const
 {
   lcosets.clear();
-  Transformations whole = *this;
+  TransIndex whole(*this);
+  vector<bool> used(whole.size(), false);
   sub += Trans3d(); // must include unit!
-  while (whole.is_set()) {
-    Trans3d tr = *whole.trans.begin(); // select a transf from init list
+  for (size_t i = 0; i < whole.size(); i++) {
+    if (used[i])
+      continue;
+    const Trans3d &tr = whole[i];      // select first unused transformation
     lcosets.push_back(sub.lcoset(tr)); // find equivalent transformations
-    whole.subtract(lcosets.back());    // remove them
+    for (const auto &t : lcosets.back()) { // mark them as used
+      const int idx = whole.find(t);
+      if (idx >= 0)
+        used[idx] = true;
+    }
   }
   return lcosets.size();
 }
@@ -172,18 +288,25 @@ Transformations &Transformations::min_set(const Transformations &tr_whole,
                                           const Transformations &tr_part,
                                           const Trans3d &pos)
 {
-  Transformations whole = tr_whole;
+  TransIndex whole(tr_whole);
+  vector<bool> used(whole.size(), false);
   Transformations part = tr_part;
   part.conjugate(pos);
   Transformations inter;
-  inter.intersection(part, whole);
+  inter.intersection(part, tr_whole);
   inter += Trans3d(); // must include unit!
 
-  while (whole.is_set()) {
-    Trans3d tr = *whole.trans.begin();        // select a transf from init list
+  for (size_t i = 0; i < whole.size(); i++) {
+    if (used[i])
+      continue;
+    const Trans3d &tr = whole[i];             // select first unused transf
     add(tr);                                  // and add it to the final list
     Transformations coset = inter.lcoset(tr); // find equivalent transformations
-    whole.subtract(coset);                    // remove them
+    for (const auto &t : coset) {             // mark them as used
+      const int idx = whole.find(t);
+      if (idx >= 0)
+        used[idx] = true;
+    }
   }
   return *this;
 }
@@ -795,15 +918,17 @@ Symmetry::Symmetry(const Transformations &ts)
   to_std *= transl; // first move the fixed point to the origin;
 }
 
-static inline int edge_seen(map<pair<int, int>, unsigned char> &e_seen, int v0,
-                            int v1, bool update)
+// traversal directions of edges, keyed by the ordered vertex index pair
+typedef std::unordered_map<long long, unsigned char> EdgeSeen;
+
+static inline int edge_seen(EdgeSeen &e_seen, int v0, int v1, bool update)
 {
   unsigned char dir = 1;
   if (v0 > v1) {
     swap(v0, v1);
     dir = 2;
   }
-  pair<int, int> edge(v0, v1);
+  const long long edge = ((long long)v0 << 32) | v1;
   auto ei = e_seen.find(edge);
   if (ei == e_seen.end()) { // not traversed in either direction
     if (update)
@@ -817,14 +942,12 @@ static inline int edge_seen(map<pair<int, int>, unsigned char> &e_seen, int v0,
   return 1;            // 1: seen but not traversed in this direction
 }
 
-static inline int edge_check(map<pair<int, int>, unsigned char> &e_seen, int v0,
-                             int v1)
+static inline int edge_check(EdgeSeen &e_seen, int v0, int v1)
 {
   return edge_seen(e_seen, v0, v1, false);
 }
 
-static inline int edge_mark(map<pair<int, int>, unsigned char> &e_seen, int v0,
-                            int v1)
+static inline int edge_mark(EdgeSeen &e_seen, int v0, int v1)
 {
   return edge_seen(e_seen, v0, v1, true);
 }
@@ -835,14 +958,17 @@ static inline int edge_mark(map<pair<int, int>, unsigned char> &e_seen, int v0,
 // ftp://ftp.iam.unibe.ch/pub/TechReports/1994/iam-94-012.ps.gz
 // 3.1.1 The algorithm of Jiang & Bunke
 
+// if max_codes is not 0 then the path is only followed until that number
+// of vertices have been coded, and 1 is returned if it matches so far
 static int find_path(vector<int> &path, vector<int> &v_code,
                      const vector<int> &edge, const vector<vector<int>> &v_cons,
                      const vector<int> *test_path = nullptr,
-                     const vector<int> *test_v_code = nullptr)
+                     const vector<int> *test_v_code = nullptr,
+                     int max_codes = 0)
 {
   path.clear();
-  v_code = vector<int>(v_cons.size(), -1);
-  map<pair<int, int>, unsigned char> e_seen;
+  v_code.assign(v_cons.size(), -1);
+  EdgeSeen e_seen;
   int v_cnt = 0;
   int v_cur = edge[0];
   path.push_back(v_cur);
@@ -887,76 +1013,409 @@ static int find_path(vector<int> &path, vector<int> &v_code,
       return 0;
 
     path.push_back(v_next);
+    if (max_codes && v_code[v_next] == max_codes - 1)
+      return 1;
     v_cur = v_next;
     v_next = v_new;
   }
 }
 
-static void update_equiv_elems(vector<map<int, set<int>>> &equiv_elems,
-                               const vector<map<int, set<int>>> &new_equivs,
-                               int cnts[3])
+// don't export these functions
+namespace {
+
+// Index of the elements of a geometry, for finding the elements that
+// a transformation maps them onto without merging geometry copies
+class SymElemIndex {
+private:
+  struct Cell {
+    long long x, y, z;
+    bool operator==(const Cell &c) const
+    {
+      return x == c.x && y == c.y && z == c.z;
+    }
+  };
+
+  struct CellHash {
+    size_t operator()(const Cell &c) const
+    {
+      size_t h = std::hash<long long>()(c.x);
+      h = h * 1000003 ^ std::hash<long long>()(c.y);
+      return h * 1000003 ^ std::hash<long long>()(c.z);
+    }
+  };
+
+  struct IdxsHash {
+    size_t operator()(const vector<int> &idxs) const
+    {
+      size_t h = idxs.size();
+      for (int idx : idxs)
+        h = h * 1000003 ^ std::hash<int>()(idx);
+      return h;
+    }
+  };
+
+  const Geometry &geom;
+  double eps;
+  double cell_size;
+  // vertices in each cell are held in a linked list
+  std::unordered_map<Cell, int, CellHash> cell_head;
+  vector<int> cell_next;
+  std::unordered_map<vector<int>, int, IdxsHash> elem_idx[2];
+
+  static bool is_finite(const Vec3d &v)
+  {
+    return v.is_set() && std::isfinite(v[0]) && std::isfinite(v[1]) &&
+           std::isfinite(v[2]);
+  }
+  Cell get_cell(const Vec3d &v) const;
+  long long get_cell_idx(double coord) const;
+  static void normalise(vector<int> &idxs);
+
+public:
+  SymElemIndex(const Geometry &geom, double eps);
+
+  /// Find the vertex coincident with a point
+  /**\param pt the point.
+   * \return The index of the only coincident vertex, or \c -1 if there
+   *  is no such vertex, or more than one. */
+  int find_vert(const Vec3d &pt) const;
+
+  /// Check whether a transformation may carry the geometry onto itself
+  /**\param trans the transformation.
+   * \return \c false if a small sample of vertices is not carried onto
+   *  vertices. */
+  bool check_sample(const Trans3d &trans) const;
+
+  /// Check whether a transformation carries the geometry onto itself
+  /**\param trans the transformation.
+   * \param elem_maps vector (0:vertices, 1:edges, 2:faces) of vectors
+   *  mapping an element index to the index of the element it is carried
+   *  onto.
+   * \return \c true if each element is carried onto a different element. */
+  bool get_maps(const Trans3d &trans, vector<vector<int>> &elem_maps) const;
+};
+
+SymElemIndex::SymElemIndex(const Geometry &geom, double eps)
+    : geom(geom), eps(eps), cell_size(4 * eps)
+{
+  const auto &verts = geom.verts();
+  cell_head.reserve(verts.size());
+  cell_next.resize(verts.size(), -1);
+  for (unsigned int i = 0; i < verts.size(); i++) {
+    if (!is_finite(verts[i]))
+      continue; // can never be found
+    auto ins = cell_head.insert({get_cell(verts[i]), (int)i});
+    if (!ins.second) {
+      cell_next[i] = ins.first->second;
+      ins.first->second = i;
+    }
+  }
+
+  const vector<vector<int>> *elems[2] = {&geom.edges(), &geom.faces()};
+  for (int i = 0; i < 2; i++) {
+    elem_idx[i].reserve(elems[i]->size());
+    for (unsigned int j = 0; j < elems[i]->size(); j++) {
+      vector<int> idxs = (*elems[i])[j];
+      normalise(idxs);
+      elem_idx[i].insert({idxs, (int)j});
+    }
+  }
+}
+
+SymElemIndex::Cell SymElemIndex::get_cell(const Vec3d &v) const
+{
+  long long idx[3];
+  for (int i = 0; i < 3; i++)
+    idx[i] = get_cell_idx(v[i]);
+  return {idx[0], idx[1], idx[2]};
+}
+
+long long SymElemIndex::get_cell_idx(double coord) const
 {
+  const double lim = 1e18; // keep the cell index in range
+  return (long long)std::max(-lim, std::min(lim, floor(coord / cell_size)));
+}
+
+// Same as the sorting of faces when merging, start at the lowest index
+// and reverse if the following index is higher than the preceding one
+void SymElemIndex::normalise(vector<int> &idxs)
+{
+  if (idxs.size() < 2)
+    return;
+  std::rotate(idxs.begin(), min_element(idxs.begin(), idxs.end()),
+              idxs.end());
+  if (idxs[1] > idxs.back())
+    reverse(idxs.begin() + 1, idxs.end());
+}
+
+int SymElemIndex::find_vert(const Vec3d &pt) const
+{
+  if (!is_finite(pt))
+    return -1;
+
+  // only visit the cells overlapped by the box of side 2*eps around pt
+  long long lo[3], hi[3];
   for (int i = 0; i < 3; i++) {
-    map<int, set<int>>::const_iterator mi_new;
-    for (mi_new = new_equivs[i].begin(); mi_new != new_equivs[i].end();
-         ++mi_new) {
-      int to = *mi_new->second.begin();
-      if (to >= cnts[i])
-        to -= cnts[i];
-      for (int si : mi_new->second) {
-        int from = (si < cnts[i]) ? si : si - cnts[i];
-        equiv_elems[i][to].insert(from);
+    lo[i] = get_cell_idx(pt[i] - eps);
+    hi[i] = get_cell_idx(pt[i] + eps);
+  }
+
+  int found = -1;
+  for (long long x = lo[0]; x <= hi[0]; x++)
+    for (long long y = lo[1]; y <= hi[1]; y++)
+      for (long long z = lo[2]; z <= hi[2]; z++) {
+        const auto it = cell_head.find({x, y, z});
+        if (it == cell_head.end())
+          continue;
+        for (int j = it->second; j != -1; j = cell_next[j]) {
+          if (!compare(geom.verts(j), pt, eps)) {
+            if (found != -1)
+              return -1; // ambiguous
+            found = j;
+          }
+        }
       }
+  return found;
+}
+
+bool SymElemIndex::check_sample(const Trans3d &trans) const
+{
+  const auto &verts = geom.verts();
+  const int num_samples = 8;
+  const int step = std::max(1, (int)verts.size() / num_samples);
+  for (unsigned int i = 0; i < verts.size(); i += step)
+    if (find_vert(trans * verts[i]) < 0)
+      return false;
+  return true;
+}
+
+bool SymElemIndex::get_maps(const Trans3d &trans,
+                            vector<vector<int>> &elem_maps) const
+{
+  const auto &verts = geom.verts();
+  const int v_sz = verts.size();
+  elem_maps.assign(3, vector<int>());
+
+  vector<int> &v_map = elem_maps[0];
+  v_map.resize(v_sz);
+  vector<char> used(v_sz, false);
+  for (int i = 0; i < v_sz; i++) {
+    const int to = find_vert(trans * verts[i]);
+    if (to < 0 || used[to])
+      return false;
+    used[to] = true;
+    v_map[i] = to;
+  }
+
+  const vector<vector<int>> *elems[2] = {&geom.edges(), &geom.faces()};
+  for (int i = 0; i < 2; i++) {
+    vector<int> &e_map = elem_maps[i + 1];
+    e_map.resize(elems[i]->size());
+    used.assign(elems[i]->size(), false);
+    vector<int> idxs;
+    for (unsigned int j = 0; j < elems[i]->size(); j++) {
+      idxs = (*elems[i])[j];
+      for (int &idx : idxs)
+        idx = v_map[idx];
+      normalise(idxs);
+      const auto it = elem_idx[i].find(idxs);
+      if (it == elem_idx[i].end() || used[it->second])
+        return false;
+      used[it->second] = true;
+      e_map[j] = it->second;
     }
   }
+
+  return true;
+}
+
+// Orbits of the vertices, edges and faces, held as union-find forests
+// that are joined by the element maps of each transformation
+class ElemOrbits {
+private:
+  vector<int> parent[3];
+
+public:
+  ElemOrbits(const Geometry &geom);
+
+  /// Find the representative element of an orbit
+  /**\param type element type (0:vertices, 1:edges, 2:faces).
+   * \param idx the element index.
+   * \return The lowest index in the orbit of the element. */
+  int find(int type, int idx);
+
+  /// Join the orbits of two elements
+  /**\param type element type (0:vertices, 1:edges, 2:faces).
+   * \param idx0 index of the first element.
+   * \param idx1 index of the second element. */
+  void join(int type, int idx0, int idx1);
+
+  /// Join the orbits of elements mapped onto each other
+  /**\param elem_maps vector (0:vertices, 1:edges, 2:faces) of vectors
+   *  mapping an element index to the index of the element it is carried
+   *  onto. */
+  void add_maps(const vector<vector<int>> &elem_maps);
+
+  /// Join the orbits of elements found coincident by check_coincidence
+  /**\param equivs the coincident elements, indexes past the end of an
+   *  element list are those of the transformed copy. */
+  void add_equivs(const vector<map<int, set<int>>> &equivs);
+
+  /// Join the orbits found for the same geometry by another object
+  /**\param orbits the other orbits. */
+  void add_orbits(ElemOrbits &orbits);
+
+  /// Get the orbits as sets of original element indexes
+  /**\param equiv_sets the sets of equivalent elements are returned here,
+   *  in order of their lowest index.
+   * \param orig_equivs the original elements merged into each element.
+   * \param orbit_ids if not \c nullptr, the index of the set of each
+   *  original element is returned here. */
+  void get_sets(vector<vector<set<int>>> &equiv_sets,
+                const vector<map<int, set<int>>> &orig_equivs,
+                vector<vector<int>> *orbit_ids = nullptr);
+};
+
+ElemOrbits::ElemOrbits(const Geometry &geom)
+{
+  const int cnts[3] = {(int)geom.verts().size(), (int)geom.edges().size(),
+                       (int)geom.faces().size()};
+  for (int i = 0; i < 3; i++) {
+    parent[i].resize(cnts[i]);
+    std::iota(parent[i].begin(), parent[i].end(), 0);
+  }
 }
 
-static void equiv_elems_to_sets(vector<vector<set<int>>> &equiv_sets,
-                                vector<map<int, set<int>>> &equiv_elems,
-                                vector<map<int, set<int>>> &orig_equivs)
+int ElemOrbits::find(int type, int idx)
+{
+  vector<int> &par = parent[type];
+  while (par[idx] != idx) {
+    par[idx] = par[par[idx]]; // path halving
+    idx = par[idx];
+  }
+  return idx;
+}
+
+void ElemOrbits::join(int type, int idx0, int idx1)
+{
+  idx0 = find(type, idx0);
+  idx1 = find(type, idx1);
+  if (idx0 < idx1)
+    parent[type][idx1] = idx0;
+  else if (idx1 < idx0)
+    parent[type][idx0] = idx1;
+}
+
+void ElemOrbits::add_maps(const vector<vector<int>> &elem_maps)
+{
+  for (int i = 0; i < 3; i++)
+    for (unsigned int from = 0; from < elem_maps[i].size(); from++)
+      join(i, from, elem_maps[i][from]);
+}
+
+void ElemOrbits::add_equivs(const vector<map<int, set<int>>> &equivs)
+{
+  for (int i = 0; i < 3; i++) {
+    const int cnt = parent[i].size();
+    for (const auto &equiv : equivs[i]) {
+      const int to = *equiv.second.begin() % cnt;
+      for (int idx : equiv.second)
+        join(i, to, idx % cnt);
+    }
+  }
+}
+
+void ElemOrbits::add_orbits(ElemOrbits &orbits)
+{
+  for (int i = 0; i < 3; i++)
+    for (unsigned int idx = 0; idx < parent[i].size(); idx++)
+      join(i, idx, orbits.find(i, idx));
+}
+
+void ElemOrbits::get_sets(vector<vector<set<int>>> &equiv_sets,
+                          const vector<map<int, set<int>>> &orig_equivs,
+                          vector<vector<int>> *orbit_ids)
 {
   equiv_sets.clear();
   equiv_sets.resize(3);
+  if (orbit_ids) {
+    orbit_ids->clear();
+    orbit_ids->resize(3);
+  }
   for (int i = 0; i < 3; i++) {
-    // map each index to the to minimum index it is equivalent to
-    map<int, int> idx_to_min_idx;
-    for (auto &mi : equiv_elems[i]) {
-      auto si = mi.second.begin();
-      int min_idx = *si;
-      for (; si != mi.second.end(); ++si) {
-        auto idx_i = idx_to_min_idx.find(*si);
-        if (idx_i == idx_to_min_idx.end())
-          idx_to_min_idx[*si] = min_idx;
-        else if (idx_i->second > min_idx)
-          idx_i->second = min_idx;
+    // the element each original element was merged into
+    vector<int> merged_idx;
+    for (const auto &equiv : orig_equivs[i])
+      for (int orig_idx : equiv.second) {
+        if (orig_idx >= (int)merged_idx.size())
+          merged_idx.resize(orig_idx + 1, -1);
+        merged_idx[orig_idx] = equiv.first;
       }
-    }
 
-    // map each minimum index to its set of equivalent indexes
-    map<int, set<int>> min_idx_to_idxs;
-    map<int, int>::const_iterator idx_i;
-    for (idx_i = idx_to_min_idx.begin(); idx_i != idx_to_min_idx.end(); ++idx_i)
-      min_idx_to_idxs[idx_i->second].insert(idx_i->first);
-
-    // Copy sets to the return argument
-    map<int, set<int>>::const_iterator midx_i;
-    for (midx_i = min_idx_to_idxs.begin(); midx_i != min_idx_to_idxs.end();
-         ++midx_i) {
-      equiv_sets[i].push_back(set<int>());
-      for (int si : midx_i->second)
-        for (auto si2 = equiv_elems[i][si].begin();
-             si2 != equiv_elems[i][si].end(); ++si2)
-          equiv_sets[i].back().insert(orig_equivs[i][*si2].begin(),
-                                      orig_equivs[i][*si2].end());
+    // an orbit is numbered when its first original element is met, so
+    // the sets are in order, and the orbit number of an element is found
+    // from the root of its orbit
+    const int orig_cnt = merged_idx.size();
+    vector<int> orbit_no(parent[i].size(), -1);
+    if (orbit_ids)
+      (*orbit_ids)[i].resize(orig_cnt, -1);
+    for (int orig_idx = 0; orig_idx < orig_cnt; orig_idx++) {
+      if (merged_idx[orig_idx] < 0)
+        continue;
+      const int root = find(i, merged_idx[orig_idx]);
+      if (orbit_no[root] < 0) {
+        orbit_no[root] = equiv_sets[i].size();
+        equiv_sets[i].push_back(set<int>());
+      }
+      auto &equiv_set = equiv_sets[i][orbit_no[root]];
+      equiv_set.insert(equiv_set.end(), orig_idx);
+      if (orbit_ids)
+        (*orbit_ids)[i][orig_idx] = orbit_no[root];
     }
-    std::sort(equiv_sets[i].begin(), equiv_sets[i].end());
   }
 }
 
-static bool is_sym(const Geometry &test_geom, const Geometry &geom,
+} // namespace
+
+// Reject most candidates without following the whole path, the
+// transformation is estimated from the first vertices of the path and
+// checked on a sample of vertices. test_c2v maps the codes of the
+// alignment vertices to the test vertex indexes, the last one being the
+// first vertex that is not colinear with the first two
+static bool is_sym_candidate(const Geometry &test_geom,
+                             const SymElemIndex &elem_index,
+                             const vector<int> &test_c2v,
+                             const vector<int> &path,
+                             const vector<int> &v_code, bool orient)
+{
+  vector<int> c2v(test_c2v.size());
+  unsigned int num_codes = 0;
+  for (int v : path)
+    if (v_code[v] == (int)num_codes && ++num_codes <= c2v.size())
+      c2v[num_codes - 1] = v;
+  if (num_codes < c2v.size())
+    return false;
+
+  vector<Vec3d> t_pts(3), pts(3);
+  const int codes[3] = {0, 1, (int)c2v.size() - 1};
+  for (int i = 0; i < 3; i++) {
+    t_pts[i] = test_geom.verts(test_c2v[codes[i]]);
+    pts[i] = test_geom.verts(c2v[codes[i]]);
+  }
+
+  if (orient)
+    transform(pts, Trans3d::inversion());
+  Trans3d trans = Trans3d::align(t_pts, pts);
+  if (orient)
+    trans = Trans3d::inversion() * trans;
+
+  return elem_index.check_sample(trans);
+}
+
+static bool is_sym(const Geometry &test_geom, const SymElemIndex &elem_index,
                    const vector<int> &test_v_code, const vector<int> &v_code,
                    bool orient, Trans3d &trans,
-                   vector<map<int, set<int>>> &new_equivs)
+                   vector<vector<int>> &elem_maps)
 {
   int v_sz = test_geom.verts().size();
   // code to vertex idx for this sym
@@ -986,23 +1445,30 @@ static bool is_sym(const Geometry &test_geom, const Geometry &geom,
   trans = Trans3d::align(t_pts, pts);
   if (orient)
     trans = Trans3d::inversion() * trans;
-  Geometry s_geom = geom;
-  s_geom.transform(trans);
 
-  return check_coincidence(geom, s_geom, &new_equivs, sym_eps);
+  return elem_index.get_maps(trans, elem_maps);
 }
 
 static void set_equiv_elems_identity(const Geometry &geom,
-                                     vector<vector<set<int>>> *equiv_sets)
+                                     vector<vector<set<int>>> *equiv_sets,
+                                     vector<vector<int>> *orbit_ids)
 {
   int cnts[3] = {(int)geom.verts().size(), (int)geom.edges().size(),
                  (int)geom.faces().size()};
   equiv_sets->clear();
   equiv_sets->resize(3);
+  if (orbit_ids) {
+    orbit_ids->clear();
+    orbit_ids->resize(3);
+  }
   for (int i = 0; i < 3; i++) {
     (*equiv_sets)[i].resize(cnts[i]);
     for (int j = 0; j < cnts[i]; j++)
       (*equiv_sets)[i][j].insert(j);
+    if (orbit_ids) {
+      (*orbit_ids)[i].resize(cnts[i]);
+      std::iota((*orbit_ids)[i].begin(), (*orbit_ids)[i].end(), 0);
+    }
   }
 }
 
@@ -1040,43 +1506,85 @@ static int find_syms(const Geometry &geom, Transformations &ts,
     reverse(r_con.begin(), r_con.end());
   const vector<vector<int>> *cons[] = {&v_cons, &r_cons};
 
-  vector<map<int, set<int>>> equiv_elems(3);
-  int cnts[3] = {(int)merged_geom.verts().size(),
-                 (int)merged_geom.edges().size(),
-                 (int)merged_geom.faces().size()};
-  vector<int> test_path, path;
-  vector<int> test_v_code, v_code;
+  vector<int> test_path;
+  vector<int> test_v_code;
   find_path(test_path, test_v_code, *edges.begin(), v_cons);
-  vector<vector<int>>::const_iterator ei;
-  for (ei = edges.begin(); ei != edges.end(); ei++) {
-    vector<int> edge = *ei;
-    for (int i = 0; i < 2; i++) {
-      if (i)
-        swap(edge[0], edge[1]);
-      for (int orient = 0; orient < 2; orient++) {
-        if (find_path(path, v_code, edge, *cons[orient], &test_path,
-                      &test_v_code)) {
-          Trans3d trans;
-          vector<map<int, set<int>>> new_equivs;
-          if (is_sym(test_geom, merged_geom, test_v_code, v_code, orient, trans,
-                     new_equivs)) {
-            ts.add(trans);
-            if (equiv_sets)
-              update_equiv_elems(equiv_elems, new_equivs, cnts);
+
+  // Vertices of the start of the test path used to estimate a candidate
+  // symmetry, ending with the first that is not colinear with the first two
+  vector<int> test_c2v(test_path.size(), -1);
+  for (int v : test_path)
+    test_c2v[test_v_code[v]] = v;
+  test_c2v.resize(std::max(3, (int)(std::find(test_c2v.begin(),
+                                              test_c2v.end(), -1) -
+                                    test_c2v.begin())));
+  for (unsigned int i = 2; i < test_c2v.size(); i++) {
+    const auto &tv = test_geom.verts();
+    Vec3d norm = vcross(tv[test_c2v[1]] - tv[test_c2v[0]],
+                        tv[test_c2v[i]] - tv[test_c2v[0]]);
+    if (norm.len2() > (anti::epsilon * anti::epsilon)) {
+      test_c2v.resize(i + 1);
+      break;
+    }
+  }
+
+  // Each candidate is a directed edge with an orientation, they are checked
+  // in parallel and the symmetries are then added in the candidate order
+  const SymElemIndex elem_index(merged_geom, sym_eps);
+  const int num_cands = 4 * edges.size();
+  vector<char> found(num_cands, false);
+  vector<Trans3d> cand_trans(num_cands);
+  vector<vector<vector<int>>> cand_maps(num_cands);
+  // a candidate may be checked against every vertex
+  const int grain =
+      std::max(DEF_PARALLEL_GRAIN / ((int)test_geom.verts().size() + 1), 1);
+  parallel_for(
+      num_cands,
+      [&](int start, int end, int) {
+        vector<int> path;
+        vector<int> v_code;
+        for (int c = start; c < end; c++) {
+          vector<int> edge = edges[c / 4];
+          if ((c / 2) % 2)
+            swap(edge[0], edge[1]);
+          const int orient = c % 2;
+          if (!find_path(path, v_code, edge, *cons[orient], &test_path,
+                         &test_v_code, test_c2v.size()) ||
+              !is_sym_candidate(test_geom, elem_index, test_c2v, path, v_code,
+                                orient))
+            continue;
+          if (find_path(path, v_code, edge, *cons[orient], &test_path,
+                        &test_v_code)) {
+            vector<vector<int>> elem_maps;
+            if (is_sym(test_geom, elem_index, test_v_code, v_code, orient,
+                       cand_trans[c], elem_maps)) {
+              found[c] = true;
+              if (equiv_sets)
+                cand_maps[c] = std::move(elem_maps);
+            }
           }
         }
-      }
+
+      },
+      0, grain);
+
+  ElemOrbits orbits(merged_geom);
+  for (int c = 0; c < num_cands; c++) {
+    if (found[c]) {
+      ts.add(cand_trans[c]);
+      if (equiv_sets)
+        orbits.add_maps(cand_maps[c]);
     }
   }
 
   if (equiv_sets)
-    equiv_elems_to_sets(*equiv_sets, equiv_elems, orig_equivs);
+    orbits.get_sets(*equiv_sets, orig_equivs);
 
   // Don't allow to fail
   if (ts.size() == 0) {
     ts.add(Trans3d());
     if (equiv_sets)
-      set_equiv_elems_identity(geom, equiv_sets);
+      set_equiv_elems_identity(geom, equiv_sets, nullptr);
   }
 
   return 1;
@@ -1291,35 +1799,59 @@ bool Symmetry::has_inversion_symmetry() const
 }
 
 void get_equiv_elems(const Geometry &geom, const Transformations &ts,
-                     vector<vector<set<int>>> *equiv_sets)
+                     vector<vector<set<int>>> *equiv_sets,
+                     vector<vector<int>> *orbit_ids)
 {
 
   equiv_sets->clear();
   if (ts.size() <= 1) {
-    set_equiv_elems_identity(geom, equiv_sets);
+    set_equiv_elems_identity(geom, equiv_sets, orbit_ids);
     return;
   }
 
   Geometry merged_geom = geom;
   vector<map<int, set<int>>> orig_equivs;
   merge_coincident_elements(merged_geom, "vef", &orig_equivs, anti::epsilon);
-  Geometry test_geom = merged_geom;
-
-  vector<map<int, set<int>>> equiv_elems(3);
-  int cnts[3] = {(int)merged_geom.verts().size(),
-                 (int)merged_geom.edges().size(),
-                 (int)merged_geom.faces().size()};
 
-  for (const auto &t : ts) {
-    Geometry trans_geom = merged_geom;
-    trans_geom.transform(t);
-    vector<map<int, set<int>>> new_equivs;
-    check_coincidence(merged_geom, trans_geom, &new_equivs, sym_eps);
-    update_equiv_elems(equiv_elems, new_equivs, cnts);
+  // Each block of transformations joins the orbits of the elements they
+  // map onto each other, found by index rather than by merging copies of
+  // the geometry. A transformation that doesn't carry the geometry onto
+  // itself only joins the elements that it makes coincident.
+  const SymElemIndex elem_index(merged_geom, sym_eps);
+  const vector<Trans3d> trans(ts.begin(), ts.end());
+  // each transformation maps all the elements, so a block needs only a few
+  const int num_elems = merged_geom.verts().size() +
+                        merged_geom.edges().size() + merged_geom.faces().size();
+  const int grain = std::max(DEF_PARALLEL_GRAIN / (num_elems + 1), 1);
+  const int num_blocks = parallel_blocks(trans.size(), 0, grain);
+  vector<ElemOrbits> blk_orbits(num_blocks, ElemOrbits(merged_geom));
+  vector<vector<int>> blk_unmapped(num_blocks);
+  parallel_for(
+      trans.size(),
+      [&](int start, int end, int blk) {
+        vector<vector<int>> elem_maps;
+        for (int i = start; i < end; i++) {
+          if (elem_index.get_maps(trans[i], elem_maps))
+            blk_orbits[blk].add_maps(elem_maps);
+          else
+            blk_unmapped[blk].push_back(i);
+        }
+      },
+      0, grain);
+
+  ElemOrbits orbits(merged_geom);
+  for (int blk = 0; blk < num_blocks; blk++) {
+    orbits.add_orbits(blk_orbits[blk]);
+    for (int i : blk_unmapped[blk]) {
+      Geometry trans_geom = merged_geom;
+      trans_geom.transform(trans[i]);
+      vector<map<int, set<int>>> new_equivs;
+      check_coincidence(merged_geom, trans_geom, &new_equivs, sym_eps);
+      orbits.add_equivs(new_equivs);
+    }
   }
 
-  if (equiv_sets)
-    equiv_elems_to_sets(*equiv_sets, equiv_elems, orig_equivs);
+  orbits.get_sets(*equiv_sets, orig_equivs, orbit_ids);
 }
 
 void Symmetry::add_sub_axes(const Symmetry &sub) const
@@ -1412,71 +1944,66 @@ void Symmetry::add_sub_axes(const Symmetry &sub) const
   }
 }
 
-class same_sym_group {
-private:
-  const Symmetry &sym;
+// Subgroups of a symmetry type and n-fold in the standard alignment
+struct Symmetry::StdSubSyms {
+  // one subgroup from each conjugacy class
+  set<Symmetry> subs;
+  // the conjugacy classes of each subgroup type, in conjugation number
+  // order, with the type and n-fold (see conj_key()) as the key
+  map<pair<int, int>, vector<Symmetry>> conj_syms;
+};
 
-public:
-  same_sym_group(const Symmetry &s) : sym(s) {}
+// don't export these functions
+namespace {
 
-  bool operator()(const Symmetry &cmp) const
-  {
-    if (cmp.get_sym_type() == sym.get_sym_type()) {
-      if (sym.get_sym_type() < Symmetry::C || sym.get_sym_type() > Symmetry::S)
-        return true;
-      else if (cmp.get_nfold() == sym.get_nfold())
-        return true;
-    }
-    return false;
+// Key for the conjugacy classes of a subgroup type, the n-fold is only
+// significant for the axial types
+pair<int, int> conj_key(const Symmetry &sym)
+{
+  const int type = sym.get_sym_type();
+  const bool axial = (type >= Symmetry::C && type <= Symmetry::S);
+  return std::make_pair(type, axial ? sym.get_nfold() : 0);
+}
+
+// Realign a subgroup in the standard alignment for a group with
+// transformation to_std to the standard alignment
+Symmetry realign_sub(const Symmetry &std_sub, const Trans3d &to_std)
+{
+  const Trans3d unit;
+  Symmetry sub = std_sub;
+  if (compare(to_std, unit, 0.0) != 0) {
+    if (compare(std_sub.get_to_std(), unit, 0.0) == 0)
+      sub.set_to_std(to_std);
+    else
+      sub.set_to_std(std_sub.get_to_std() * to_std);
   }
-};
+  return sub;
+}
+
+} // namespace
 
-static Status create_sub_sym(const Symmetry &full, Symmetry *sub,
-                             const Symmetry &sub_sym, int conj_type)
+Status Symmetry::get_sub_sym(const Symmetry &sub_sym, Symmetry *sub,
+                             int conj_type) const
 {
   *sub = Symmetry(Symmetry::unknown);
   if (conj_type < 0)
     return Status::error("conjugation type number cannot be negative");
 
-  const set<Symmetry> &sub_syms = full.get_sub_syms();
-  auto si = sub_syms.begin();
-  same_sym_group cmp(sub_sym);
-
-  // To minimise realignment of first conjugate subgroup, order on magnitude
-  // of difference of to_std rotations applied to a general test vector
-  std::multimap<double, Symmetry> conj_syms;
-  while ((si = find_if(si, sub_syms.end(), cmp)) != sub_syms.end()) {
-    const Vec3d test_v(1.1, 2.0, M_PI); // not on any axis!
-    Vec3d d = full.get_to_std() * test_v - si->get_to_std() * test_v;
-    conj_syms.insert(std::make_pair(d.len(), *si));
-    ++si;
-  }
-
-  if (!conj_syms.size())
+  const auto &conj_syms = get_std_sub_syms().conj_syms;
+  auto ci = conj_syms.find(conj_key(sub_sym));
+  if (ci == conj_syms.end())
     return Status::error(msg_str("%s is not a sub-symmetry of %s",
                                  sub_sym.get_symbol().c_str(),
-                                 full.get_symbol().c_str()));
-  if (conj_type >= (int)conj_syms.size())
+                                 get_symbol().c_str()));
+  if (conj_type >= (int)ci->second.size())
     return Status::error(
         msg_str("conjugation type too large for %s (last number: %d)",
-                sub_sym.get_symbol().c_str(), (int)conj_syms.size() - 1));
-
-  // valid
-  auto mi = conj_syms.begin();
-  int cnt = 0;
-  while (cnt++ != conj_type)
-    mi++;
-  *sub = mi->second;
+                sub_sym.get_symbol().c_str(), (int)ci->second.size() - 1));
 
+  *sub = realign_sub(ci->second[conj_type], to_std);
   return Status::ok();
 }
 
-Status Symmetry::get_sub_sym(const Symmetry &sub_sym, Symmetry *sub,
-                             int conj_type) const
-{
-  return create_sub_sym(*this, sub, sub_sym, conj_type);
-}
-
 Status Symmetry::get_sub_sym(const string &sub_name, Symmetry *sub) const
 {
   *sub = Symmetry();
@@ -1503,7 +2030,7 @@ Status Symmetry::get_sub_sym(const string &sub_name, Symmetry *sub) const
   return Status::ok();
 }
 
-const set<Symmetry> &Symmetry::get_sub_syms() const
+void Symmetry::find_sub_syms() const
 {
   sub_syms.clear();
   const Vec3d axis = Vec3d::Z;
@@ -1745,6 +2272,79 @@ const set<Symmetry> &Symmetry::get_sub_syms() const
       break;
     }
   }
+}
+
+// don't export these functions
+namespace {
+
+// Subgroups of each symmetry type and n-fold in the standard alignment,
+// found when first needed. The finder is passed the symmetry to find the
+// subgroups of, in the standard alignment.
+template <class SubSyms> class SubSymTable {
+private:
+  std::map<std::pair<int, int>, SubSyms> subs;
+  std::mutex mtx;
+
+public:
+  const SubSyms &
+  get(const Symmetry &sym,
+      const std::function<void(const Symmetry &, SubSyms &)> &finder)
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto key = std::make_pair(sym.get_sym_type(), sym.get_nfold());
+    auto si = subs.find(key);
+    if (si == subs.end()) {
+      si = subs.insert(std::make_pair(key, SubSyms())).first;
+      finder(sym, si->second);
+    }
+    return si->second;
+  }
+};
+
+} // namespace
+
+const Symmetry::StdSubSyms &Symmetry::get_std_sub_syms() const
+{
+  static SubSymTable<StdSubSyms> table;
+  static const StdSubSyms no_subs;
+  if (sym_type == unknown)
+    return no_subs;
+
+  // A symmetry found from a model may have an n-fold value for a type
+  // that doesn't take one, so this is kept (in the table key too)
+  Symmetry std_sym = *this;
+  std_sym.to_std = Trans3d();
+  std_sym.autos = SymmetryAutos();
+  std_sym.sub_syms.clear();
+  return table.get(std_sym, [](const Symmetry &sym, StdSubSyms &std_subs) {
+    sym.find_sub_syms();
+    std_subs.subs = sym.sub_syms;
+
+    // To minimise realignment of first conjugate subgroup, order on
+    // magnitude of difference of to_std rotations applied to a general
+    // test vector
+    const Vec3d test_v(1.1, 2.0, M_PI); // not on any axis!
+    map<pair<int, int>, std::multimap<double, const Symmetry *>> conjs;
+    for (const auto &sub : std_subs.subs) {
+      const Vec3d d = test_v - sub.get_to_std() * test_v;
+      conjs[conj_key(sub)].insert(std::make_pair(d.len(), &sub));
+    }
+    for (const auto &kc : conjs) {
+      auto &conj_syms = std_subs.conj_syms[kc.first];
+      for (const auto &ds : kc.second)
+        conj_syms.push_back(*ds.second);
+    }
+  });
+}
+
+const set<Symmetry> &Symmetry::get_sub_syms() const
+{
+  if (sub_syms.size() == 0 && sym_type != unknown) {
+    // Realign the standard subgroups, which have already been reduced to
+    // one for each conjugacy class
+    for (const auto &std_sub : get_std_sub_syms().subs)
+      sub_syms.insert(realign_sub(std_sub, to_std));
+  }
 
   return sub_syms;
 }
@@ -2355,6 +2955,43 @@ SymmetricUpdater::SymmetricUpdater(const Geometry &base_geom, Symmetry sym)
   const vector<set<int>> &v_equiv_sets = equiv_sets[VERTS];
   for (size_t orbit_idx = 0; orbit_idx < v_equiv_sets.size(); orbit_idx++)
     init_vert_orbit(orbit_idx, v_equiv_sets[orbit_idx]);
+  init_schedule();
+}
+
+void SymmetricUpdater::init_schedule()
+{
+  const int v_sz = geom.verts().size();
+  sched_principal.assign(v_sz, -1);
+  sched_trans.assign(v_sz, Trans3d());
+  for (int i = 0; i < v_sz; i++) {
+    const auto &orb = orbit_mapping[i];
+    if (orb.get_orbit_no() < 0)
+      continue; // not on a mapped orbit, never updated
+    const int orb_vert_idx = orbit_vertex_idx[orb.get_orbit_no()];
+    if (orb_vert_idx != i) { // don't map if this is the principal vertex
+      sched_principal[i] = orb_vert_idx;
+      sched_trans[i] = orb.get_trans_from();
+    }
+  }
+
+  // every vertex starts out of date, so it is set from its principal
+  // vertex on first use
+  orbit_update_cnt.assign(orbit_vertex_idx.size(), 1);
+  vert_update_cnt.assign(v_sz, 0);
+}
+
+void SymmetricUpdater::update_vert(int v_idx)
+{
+  const int p_idx = sched_principal[v_idx];
+  if (p_idx < 0)
+    return;
+  const unsigned int cnt =
+      orbit_update_cnt[orbit_mapping[v_idx].get_orbit_no()];
+  if (vert_update_cnt[v_idx] != cnt) {
+    Vec3d *verts = geom.raw_verts().data();
+    transform(verts + p_idx, 1, sched_trans[v_idx], verts + v_idx);
+    vert_update_cnt[v_idx] = cnt;
+  }
 }
 
 vector<int> SymmetricUpdater::get_principal(int type)
@@ -2422,24 +3059,55 @@ void SymmetricUpdater::update_principal_vertex(int v_idx, Vec3d point)
   const auto &subspace = orbit_invariant_subspaces[orb.get_orbit_no()];
   geom.verts(orb_vert_idx) =
       subspace.nearest_point(geom.verts(orb_vert_idx)).with_len(point.len());
+  orbit_update_cnt[orb.get_orbit_no()]++; // the orbit vertices are stale
 }
 
 Vec3d SymmetricUpdater::update_from_principal_vertex(int v_idx)
 {
-  const auto &orb = orbit_mapping[v_idx];
-  const int orb_vert_idx = orbit_vertex_idx[orb.get_orbit_no()];
+  update_vert(v_idx);
+  return geom.verts(v_idx);
+}
 
-  // Update the value from the principal orbit vertex
-  if (orb_vert_idx != v_idx) // don't map if this is the principal vertex
-    geom.verts(v_idx) = orb.get_trans_from() * geom.verts(orb_vert_idx);
+// An update is a single transformation, so a block needs many vertices
+static const int update_grain = 8 * DEF_PARALLEL_GRAIN;
 
-  return geom.verts(v_idx);
+void SymmetricUpdater::update_from_principal_verts(const vector<int> &v_idxs)
+{
+  // the lists are usually short, and are updated on every iteration
+  const int num = v_idxs.size();
+  if (parallel_blocks(num, 0, update_grain) < 2) {
+    for (int v_idx : v_idxs)
+      update_vert(v_idx);
+    return;
+  }
+
+  // each vertex is written only once, and principal vertices are not
+  // written, so the vertices can be updated in any order
+  parallel_for(
+      num,
+      [&](int start, int end, int) {
+        for (int i = start; i < end; i++)
+          update_vert(v_idxs[i]);
+      },
+      0, update_grain);
 }
 
 void SymmetricUpdater::update_all()
 {
-  for (unsigned int i = 0; i < geom.verts().size(); i++)
-    update_from_principal_vertex(i);
+  const int num = geom.verts().size();
+  if (parallel_blocks(num, 0, update_grain) < 2) {
+    for (int i = 0; i < num; i++)
+      update_vert(i);
+    return;
+  }
+
+  parallel_for(
+      num,
+      [&](int start, int end, int) {
+        for (int i = start; i < end; i++)
+          update_vert(i);
+      },
+      0, update_grain);
 }
 
 const Geometry &SymmetricUpdater::get_geom_final()
@@ -286,9 +286,13 @@ inline bool operator==(const Transformations &t0, const Transformations &t1)
 /**\param geom the geometry.
  * \param ts the set of transfromations to apply.
  * \param equiv_sets vectors of sets of equivalent elements for
- *  vertices (0), edges (1) and faces (2). */
+ *  vertices (0), edges (1) and faces (2).
+ * \param orbit_ids if not \c nullptr, vectors for vertices (0), edges (1)
+ *  and faces (2) that map each element index to the index of its set in
+ *  \a equiv_sets are returned here. */
 void get_equiv_elems(const Geometry &geom, const Transformations &ts,
-                     std::vector<std::vector<std::set<int>>> *equiv_sets);
+                     std::vector<std::vector<std::set<int>>> *equiv_sets,
+                     std::vector<std::vector<int>> *orbit_ids = nullptr);
 /// Subspace
 class Subspace {
 public:
@@ -458,19 +462,31 @@ private:
   SymmetryAutos autos;
   Trans3d to_std;
 
+  struct StdSubSyms;
+
   void add_sub_axes(const Symmetry &sub) const;
+  void find_sub_syms() const;
+  const StdSubSyms &get_std_sub_syms() const;
   void find_full_sym_type(const std::set<SymmetryAxis> &full_sym);
 
   /// Set the symmetry type for the axis
   /**\param type the symmetry type of the axis as the Schoenflies
    *  identifier. */
-  void set_sym_type(int type) { sym_type = type; }
+  void set_sym_type(int type)
+  {
+    sym_type = type;
+    sub_syms.clear();
+  }
 
   /// Set the n-fold order of the axis.
   /** If the symmetry type is \c sym_S then the axis has
    *  rotational n/2-fold symmetry.
    * \param n the n-fold order of the axis. */
-  void set_nfold(int n) { nfold = n; }
+  void set_nfold(int n)
+  {
+    nfold = n;
+    sub_syms.clear();
+  }
 
 public:
   /// Constructor
@@ -564,7 +580,11 @@ public:
   /// Set the tranformation to standard symmetry type.
   /**\param trans the transformation that carries an object with the
    *  symmetry type onto the standard set of symmetries for that type. */
-  void set_to_std(const Trans3d &trans) { to_std = trans; }
+  void set_to_std(const Trans3d &trans)
+  {
+    to_std = trans;
+    sub_syms.clear();
+  }
 
   /// Get the symmetry transformations
   /**\param ts to return the set of symmetry transformations for this
@@ -577,7 +597,9 @@ public:
   Transformations get_trans() const;
 
   /// Get the symmetry subgroups
-  /** Only one example is included from each conjugacy class
+  /** Only one example is included from each conjugacy class. The
+   *  subgroups of each symmetry type are found once, in the standard
+   *  alignment, and realigned for this symmetry when first requested.
    * \return The symmetry subgroups. */
   const std::set<Symmetry> &get_sub_syms() const;
 
@@ -592,7 +614,7 @@ public:
   /**\param sub_sym the symmetry subgroup
    * \param sub to return the symmetry subgroup
    * \param conj_type use to select from inequivalent (non-conjugate)
-   *  subgroups.
+   *  subgroups, which are numbered in the standard alignment.
    * \return status, evaluates to \c true if the symmetry subgroup
    *  could be found, otherwise \c false.*/
   Status get_sub_sym(const Symmetry &sub_sym, Symmetry *sub,
@@ -800,6 +822,13 @@ public:
    * \return the updated vertex coordinates */
   Vec3d update_from_principal_vertex(int v_idx);
 
+  /// Update vertex locations using the principal orbit vertices
+  /**The vertices are updated in a single pass, in parallel. A vertex is
+   * only updated if its principal vertex has changed since the vertex
+   * was last updated.
+   * \param v_idxs the indexes of the vertices to update, without repeats */
+  void update_from_principal_verts(const std::vector<int> &v_idxs);
+
   /// Update all vertex locations using principal orbit vertices
   void update_all();
 
@@ -825,7 +854,18 @@ private:
   std::vector<Subspace> orbit_invariant_subspaces;
   std::vector<ElemOrbitMapping> orbit_mapping;
 
+  // Update schedule, the principal vertex of each vertex (-1 for a
+  // principal vertex) and the transformation that carries it onto the
+  // vertex. A vertex is out of date when the update count of its orbit
+  // differs from the count when the vertex was last updated.
+  std::vector<int> sched_principal;
+  std::vector<Trans3d> sched_trans;
+  std::vector<unsigned int> orbit_update_cnt;
+  std::vector<unsigned int> vert_update_cnt;
+
   void init_vert_orbit(int orbit_idx, const std::set<int> &orbit);
+  void init_schedule();
+  void update_vert(int v_idx);
 };
 
 /// Get element equivalence transformations
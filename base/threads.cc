@@ -0,0 +1,228 @@
+/*
+   Copyright (c) 2026, Adrian Rossiter
+
+   Antiprism - http://www.antiprism.com
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+      The above copyright notice and this permission notice shall be included
+      in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+
+/* \file threads.cc
+   \brief Thread utilities
+*/
+
+#include "threads.h"
+
+#ifdef HAVE_CONFIG_H
+#include "../config.h"
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+#include <vector>
+
+#ifdef HAVE_PTHREAD
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace anti {
+
+// don't export these
+namespace {
+
+std::atomic<int> num_threads_setting(0); // 0 - use default
+
+int find_default_num_threads()
+{
+  int num = 0;
+  const char *env_threads = getenv("ANTIPRISM_THREADS");
+  if (env_threads)
+    num = atoi(env_threads);
+#ifdef HAVE_PTHREAD
+  if (num < 1)
+    num = std::thread::hardware_concurrency();
+#endif
+  return std::max(num, 1);
+}
+
+#ifdef HAVE_PTHREAD
+// Threads that are kept for running the blocks of parallel loops. The
+// calling thread runs the first block, and pool threads run the others.
+class ThreadPool {
+private:
+  std::mutex mtx;
+  std::condition_variable work_cv; // blocks to run, or stopping
+  std::condition_variable done_cv; // pool blocks finished
+  std::vector<std::thread> threads;
+  const std::function<void(int)> *blk_task = nullptr;
+  int num_blks = 0;    // number of blocks in the current loop
+  int next_blk = 0;    // next block to hand to a pool thread
+  int num_running = 0; // pool blocks not yet finished
+  bool stopping = false;
+
+  void work();
+
+public:
+  ThreadPool() = default;
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  ~ThreadPool();
+
+  // Run blk_task for blocks 0 to num_blks-1, it must not throw
+  void run(int num_blks, const std::function<void(int)> &blk_task);
+};
+
+void ThreadPool::work()
+{
+  std::unique_lock<std::mutex> lock(mtx);
+  while (true) {
+    work_cv.wait(lock, [this] { return stopping || next_blk < num_blks; });
+    if (stopping)
+      return;
+    const int blk = next_blk++;
+    lock.unlock();
+    (*blk_task)(blk);
+    lock.lock();
+    if (--num_running == 0)
+      done_cv.notify_one();
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+  }
+  work_cv.notify_all();
+  for (auto &thread : threads)
+    thread.join();
+}
+
+void ThreadPool::run(int blks, const std::function<void(int)> &task)
+{
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    while ((int)threads.size() < blks - 1)
+      threads.emplace_back(&ThreadPool::work, this);
+    blk_task = &task;
+    num_blks = blks;
+    next_blk = 1;
+    num_running = blks - 1;
+  }
+  work_cv.notify_all();
+
+  task(0); // first block on this thread
+
+  std::unique_lock<std::mutex> lock(mtx);
+  done_cv.wait(lock, [this] { return num_running == 0; });
+  blk_task = nullptr;
+  num_blks = 0;
+  next_blk = 0;
+}
+
+// The pool runs one loop at a time. A loop started while it is busy, from
+// a loop body or another thread, runs its blocks on the calling thread.
+std::atomic<bool> pool_busy(false);
+
+ThreadPool &get_pool()
+{
+  // never destroyed, so exit() is not held up by joining pool threads
+  static ThreadPool *pool = new ThreadPool; // thread-safe
+  return *pool;
+}
+#endif // HAVE_PTHREAD
+
+} // namespace
+
+int get_num_threads()
+{
+  const int num = num_threads_setting.load();
+  if (num > 0)
+    return num;
+
+  static const int default_num = find_default_num_threads(); // thread-safe
+  return default_num;
+}
+
+void set_num_threads(int num_threads)
+{
+  num_threads_setting = std::max(num_threads, 0);
+}
+
+int parallel_blocks(int num, int num_threads, int grain)
+{
+  if (num < 1)
+    return 0;
+  if (num_threads < 1)
+    num_threads = get_num_threads();
+  return std::max(std::min(num / std::max(grain, 1), num_threads), 1);
+}
+
+void parallel_for(int num, const std::function<void(int, int, int)> &body,
+                  int num_threads, int grain)
+{
+  const int num_blks = parallel_blocks(num, num_threads, grain);
+  auto blk_start = [&](int blk) {
+    return (int)((long long)num * blk / num_blks);
+  };
+
+#ifdef HAVE_PTHREAD
+  if (num_blks > 1 && !pool_busy.exchange(true)) {
+    // an exception in a block is passed back to this thread
+    std::vector<std::exception_ptr> excepts(num_blks);
+    get_pool().run(num_blks, [&](int blk) {
+      try {
+        body(blk_start(blk), blk_start(blk + 1), blk);
+      }
+      catch (...) {
+        excepts[blk] = std::current_exception();
+      }
+    });
+    pool_busy = false;
+    for (const auto &except : excepts)
+      if (except)
+        std::rethrow_exception(except);
+    return;
+  }
+#endif
+
+  for (int blk = 0; blk < num_blks; blk++)
+    body(blk_start(blk), blk_start(blk + 1), blk);
+}
+
+void parallel_for_strided(int num, const std::function<void(int, int)> &body,
+                          int num_threads, int grain)
+{
+  const int num_blks = parallel_blocks(num, num_threads, grain);
+  parallel_for(
+      num_blks,
+      [&](int start, int end, int) {
+        for (int blk = start; blk < end; blk++)
+          for (int i = blk; i < num; i += num_blks)
+            body(i, blk);
+      },
+      num_blks, 1);
+}
+
+} // namespace anti
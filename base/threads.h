@@ -0,0 +1,103 @@
+/*
+   Copyright (c) 2026, Adrian Rossiter
+
+   Antiprism - http://www.antiprism.com
+
+   Permission is hereby granted, free of charge, to any person obtaining a
+   copy of this software and associated documentation files (the "Software"),
+   to deal in the Software without restriction, including without limitation
+   the rights to use, copy, modify, merge, publish, distribute, sublicense,
+   and/or sell copies of the Software, and to permit persons to whom the
+   Software is furnished to do so, subject to the following conditions:
+
+      The above copyright notice and this permission notice shall be included
+      in all copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+  IN THE SOFTWARE.
+*/
+
+
+/**\file threads.h
+   \brief Thread utilities
+*/
+
+#ifndef THREADS_H
+#define THREADS_H
+
+#include <functional>
+
+namespace anti {
+
+/// Default minimum number of loop indexes in a block of a parallel loop
+/** A loop with fewer than twice this number of indexes runs on the calling
+ *  thread, as handing a block with a cheap loop body to another thread
+ *  costs more than it saves. */
+const int DEF_PARALLEL_GRAIN = 2048;
+
+/// Get the number of threads to use for parallel processing
+/** If the number has not been set then it is taken from the environment
+ *  variable \c ANTIPRISM_THREADS, or failing that the number of hardware
+ *  threads.
+ * \return The number of threads, always at least \c 1. */
+int get_num_threads();
+
+/// Set the number of threads to use for parallel processing
+/**\param num_threads the number of threads, or \c 0 to use the default. */
+void set_num_threads(int num_threads);
+
+/// Get the number of blocks a parallel loop will be divided into
+/**\param num the number of loop indexes.
+ * \param num_threads the number of threads, or \c 0 to use
+ *  \c get_num_threads()
+ * \param grain the minimum number of loop indexes in a block, use a
+ *  lower value when the loop body is costly.
+ * \return The number of blocks. */
+int parallel_blocks(int num, int num_threads = 0,
+                    int grain = DEF_PARALLEL_GRAIN);
+
+/// Run a loop in parallel
+/** The index range is divided into contiguous blocks, one for each
+ *  thread, and the loop body is called once for each block. The first
+ *  block runs on the calling thread, and the others on threads that are
+ *  kept for later loops. A loop started inside a loop body runs all its
+ *  blocks on the calling thread. The blocks,
+ *  and their numbers, only depend on \a num and the number of threads,
+ *  so per-block results may be combined in a repeatable order. If the
+ *  body throws an exception, the other blocks are still completed, and the
+ *  exception from the lowest numbered block is rethrown on the calling
+ *  thread.
+ * \param num the number of loop indexes, \c 0 to \c num-1.
+ * \param body the loop body, called with the start index of the block,
+ *  the end index (one past the last index) of the block, and the block
+ *  number.
+ * \param num_threads the number of threads, or \c 0 to use
+ *  \c get_num_threads()
+ * \param grain the minimum number of loop indexes in a block, use a
+ *  lower value when the loop body is costly. */
+void parallel_for(int num, const std::function<void(int, int, int)> &body,
+                  int num_threads = 0, int grain = DEF_PARALLEL_GRAIN);
+
+/// Run a loop in parallel, with the indexes interleaved between blocks
+/** Index \c i is processed in block \c i \c % \c n, in increasing order
+ *  within the block, where \c n is the number of blocks found by
+ *  parallel_blocks(). This shares out the work when the cost of an index
+ *  varies smoothly across the range.
+ * \param num the number of loop indexes, \c 0 to \c num-1.
+ * \param body the loop body, called with the index and the block number.
+ * \param num_threads the number of threads, or \c 0 to use
+ *  \c get_num_threads()
+ * \param grain the minimum number of loop indexes in a block, use a
+ *  lower value when the loop body is costly. */
+void parallel_for_strided(int num, const std::function<void(int, int)> &body,
+                          int num_threads = 0,
+                          int grain = DEF_PARALLEL_GRAIN);
+
+} // namespace anti
+
+#endif // THREADS_H
@@ -29,6 +29,7 @@
 #include "trans3d.h"
 #include "mathutils.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <vector>
 
@@ -202,12 +203,16 @@ Trans3d Trans3d::inverse() const
 
 Trans3d &Trans3d::operator*=(const Trans3d &trans)
 {
-  Trans3d new_m = zero();
-  for (int i = 0; i < 16; i++)
-    for (int j = 0; j < 4; j++)
-      new_m[i] += m[(i / 4) * 4 + j] * trans[(j)*4 + (i % 4)];
-
-  *this = new_m;
+  // sums start from zero and add the terms in order, as in the original
+  // accumulation into a zero matrix, so results are unchanged
+  double new_m[16];
+  const double *t = trans.m;
+  for (int r = 0; r < 16; r += 4)
+    for (int c = 0; c < 4; c++)
+      new_m[r + c] = 0.0 + m[r] * t[c] + m[r + 1] * t[4 + c] +
+                     m[r + 2] * t[8 + c] + m[r + 3] * t[12 + c];
+
+  std::copy(new_m, new_m + 16, m);
   return *this;
 }
 
@@ -223,6 +228,25 @@ Vec3d operator*(const Trans3d &trans, const Vec3d &vec)
   return new_v;
 }
 
+void transform(const Vec3d *vecs, size_t num, const Trans3d &trans,
+               Vec3d *out)
+{
+  const double m0 = trans[0], m1 = trans[1], m2 = trans[2], m3 = trans[3];
+  const double m4 = trans[4], m5 = trans[5], m6 = trans[6], m7 = trans[7];
+  const double m8 = trans[8], m9 = trans[9], m10 = trans[10],
+               m11 = trans[11];
+  for (size_t i = 0; i < num; i++) {
+    const double x = vecs[i][0];
+    const double y = vecs[i][1];
+    const double z = vecs[i][2];
+    // same order of operations as operator*, including the initial zero,
+    // so results match to the last bit (and sign of zero)
+    out[i][0] = 0.0 + m0 * x + m1 * y + m2 * z + m3;
+    out[i][1] = 0.0 + m4 * x + m5 * y + m6 * z + m7;
+    out[i][2] = 0.0 + m8 * x + m9 * y + m10 * z + m11;
+  }
+}
+
 Vec4d operator*(const Trans3d &trans, const Vec4d &vec)
 {
   auto new_v = Vec4d::zero;
@@ -285,6 +285,16 @@ bool operator<(const Trans3d &trans1, const Trans3d &trans2);
  * \param trans the transformation to apply. */
 void transform(std::vector<Vec3d> &vecs, const Trans3d &trans);
 
+/// Transform a block of vectors
+/** The results are the same as for \c trans*vec, but the matrix entries
+ *  are loaded once and the loop is simple enough to be vectorised.
+ * \param vecs the (column) vectors to transform.
+ * \param num the number of vectors.
+ * \param trans the transformation to apply.
+ * \param out the start of the transformed vectors, which may be \a vecs. */
+void transform(const Vec3d *vecs, size_t num, const Trans3d &trans,
+               Vec3d *out);
+
 // inline functions
 inline Trans3d::Trans3d()
 {
@@ -401,8 +411,7 @@ inline bool operator==(const Trans3d &trans1, const Trans3d &trans2)
 
 inline void transform(std::vector<Vec3d> &vecs, const Trans3d &trans)
 {
-  for (auto &v : vecs)
-    v = trans * v;
+  transform(vecs.data(), vecs.size(), trans, vecs.data());
 }
 
 } // namespace anti
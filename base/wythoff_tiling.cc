@@ -119,7 +119,7 @@ static void make_meta(const Geometry &geom, Geometry &meta,
 static Status normalize_tri(Geometry &geom, int f_idx, int v0, int v1,
                             Color other_v_col)
 {
-  vector<int> &face = geom.faces(f_idx);
+  vector<int> &face = geom.faces_mut(f_idx);
   if (face.size() != 3)
     return Status::error(msg_str("face %d is not a triangle", f_idx));
   bool found = false;
@@ -512,7 +512,7 @@ static void reverse_odd_faces(Geometry &geom)
   const int f_sz = geom.faces().size();
   for (int i = 0; i < f_sz; i++)
     if (i % 2)
-      reverse(geom.faces(i).begin(), geom.faces(i).end());
+      reverse(geom.faces_mut(i).begin(), geom.faces_mut(i).end());
 }
 
 Status Tiling::set_geom(const Geometry &geom, bool is_meta, double face_ht)
@@ -428,6 +428,8 @@ Options
   -l <lim>  minimum distance change to terminate, as negative exponent
                (default: %d giving %.0e)
             WARNING: high values can cause non-terminal behaviour. Use -n
+  -j <num>  number of threads for the poly_form planarization and
+            canonicalization methods (default: %d)
   -o <file> write output to file (default: write to standard output)
 
 Canonical and Planarization Options
@@ -506,7 +508,8 @@ keyword: none - sets no color, u - input base model, color of element unchanged
 )",
       prog_name(), help_ver_text, it_ctrl.get_status_check_and_report_iters(),
       it_ctrl.get_status_check_only_iters(), it_ctrl.get_sig_digits(),
-      it_ctrl.get_test_val(), it_ctrl.get_max_iters(), it_ctrl.get_max_iters());
+      it_ctrl.get_test_val(), get_num_threads(), it_ctrl.get_max_iters(),
+      it_ctrl.get_max_iters());
 }
 
 void cn_opts::process_command_line(int argc, char **argv)
@@ -539,10 +542,13 @@ void cn_opts::process_command_line(int argc, char **argv)
   for (int i = 0; i < 3; i++)
     std::fill(off_opacity[i], off_opacity[i] + col_total, -1);
 
+  // threads only pay for large models, so use one unless set with -j
+  set_num_threads(1);
+
   handle_long_opts(argc, argv);
 
   while ((c = getopt(argc, argv,
-                     ":hHe:s:t:p:i:c:n:yO:q:g:Q:P:f:Cd:Yz:V:E:F:m:l:o:")) !=
+                     ":hHe:s:t:p:i:c:n:yO:q:g:Q:P:f:Cd:Yz:V:E:F:m:l:j:o:")) !=
          -1) {
     if (common_opts(c, optopt))
       continue;
@@ -702,6 +708,13 @@ void cn_opts::process_command_line(int argc, char **argv)
       print_status_or_exit(it_ctrl.set_sig_digits(num), c);
       break;
 
+    case 'j':
+      print_status_or_exit(read_int(optarg, &num), c);
+      if (num < 1)
+        error("number of threads must be 1 or more", c);
+      set_num_threads(num);
+      break;
+
     case 'o':
       ofile = optarg;
       break;
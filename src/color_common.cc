@@ -437,14 +437,16 @@ void color_faces_by_connection(Geometry &geom, Coloring &clrng, bool apply_map)
   // transfer edge and vertex colors from geom
   // if elements were invisible, mark them maximum
   // only non-counted element will remain invisible
+  // vertices are looked up in an index, as find_vert_by_coords() would
+  PointIndex vert_index(geom.verts(), 4 * anti::epsilon);
   for (unsigned int i = 0; i < kis.edges().size(); i++) {
-    unsigned int v_idx[2];
-    Vec3d v[2];
-    for (unsigned int j = 0; j < 2; j++) {
-      v_idx[j] = kis.edges(i)[j];
-      v[j] = kis.verts(v_idx[j]);
-    }
-    int geom_edge_no = find_edge_by_coords(geom, v[0], v[1], anti::epsilon);
+    int geom_v_idxs[2];
+    for (unsigned int j = 0; j < 2; j++)
+      geom_v_idxs[j] = vert_index.find_coincident(kis.edge_v(i, j),
+                                                  anti::epsilon);
+    int geom_edge_no = (geom_v_idxs[0] != -1 && geom_v_idxs[1] != -1)
+                           ? geom.find_edge(geom_v_idxs[0], geom_v_idxs[1])
+                           : -1;
     Color col;
     if (geom_edge_no > -1) {
       col = geom.colors(EDGES).get(geom_edge_no);
@@ -456,8 +458,7 @@ void color_faces_by_connection(Geometry &geom, Coloring &clrng, bool apply_map)
     }
     for (unsigned int j = 0; j < 2; j++) {
       int ev = kis.edges(i)[j];
-      int geom_v_idx =
-          find_vert_by_coords(geom, kis.verts()[ev], anti::epsilon);
+      int geom_v_idx = geom_v_idxs[j];
       if (geom_v_idx > -1) {
         col = geom.colors(VERTS).get(geom_v_idx);
         if (col.is_invisible())
@@ -531,16 +532,17 @@ Status color_faces_by_connection_vef(Geometry &geom, OffColor &off_color)
 
   // reassert invisible elements from kis operation
   if (op && strchr("hH", op)) {
+    // vertices are looked up in an index, as find_vert_by_coords() would
+    PointIndex vert_index(geom_save.verts(), 4 * anti::epsilon);
     for (unsigned int i = 0; i < geom.edges().size(); i++) {
-      unsigned int v_idx[2];
-      Vec3d v[2];
-      for (unsigned int j = 0; j < 2; j++) {
-        v_idx[j] = geom.edges(i)[j];
-        v[j] = geom.verts(v_idx[j]);
-      }
+      int save_idxs[2];
+      for (unsigned int j = 0; j < 2; j++)
+        save_idxs[j] = vert_index.find_coincident(geom.edge_v(i, j),
+                                                  anti::epsilon);
       Color col;
-      int save_edge_no =
-          find_edge_by_coords(geom_save, v[0], v[1], anti::epsilon);
+      int save_edge_no = (save_idxs[0] != -1 && save_idxs[1] != -1)
+                             ? geom_save.find_edge(save_idxs[0], save_idxs[1])
+                             : -1;
       if (save_edge_no > -1) {
         col = geom_save.colors(EDGES).get(save_edge_no);
         if (col.is_invisible())
@@ -548,8 +550,7 @@ Status color_faces_by_connection_vef(Geometry &geom, OffColor &off_color)
       }
       for (unsigned int j = 0; j < 2; j++) {
         int ev = geom.edges(i)[j];
-        int save_idx =
-            find_vert_by_coords(geom_save, geom.verts()[ev], anti::epsilon);
+        int save_idx = save_idxs[j];
         col = geom_save.colors(VERTS).get(save_idx);
         if (col.is_invisible())
           geom.colors(VERTS).set(ev, col);
@@ -42,6 +42,7 @@ using namespace anti;
 class ch_opts : public ProgramOpts {
 public:
   bool append_flg;
+  bool prefilter = false;
   string ifile;
   string ofile;
   string qh_args;
@@ -62,6 +63,8 @@ input_file is not given the program reads from standard input.
 Options
 %s
   -a        append the convex hull to the input file
+  -p        pass only the points that may be on the hull to qhull, faster
+            when most points are inside (elements may be in another order)
   -Q <args> additional arguments to pass to qhull (unsupported, may not
             work, check output)
   -o <file> write output to file (default: write to standard output)
@@ -77,7 +80,7 @@ void ch_opts::process_command_line(int argc, char **argv)
 
   handle_long_opts(argc, argv);
 
-  while ((c = getopt(argc, argv, ":haQ:o:")) != -1) {
+  while ((c = getopt(argc, argv, ":hapQ:o:")) != -1) {
     if (common_opts(c, optopt))
       continue;
 
@@ -86,6 +89,10 @@ void ch_opts::process_command_line(int argc, char **argv)
       append_flg = true;
       break;
 
+    case 'p':
+      prefilter = true;
+      break;
+
     case 'o':
       ofile = optarg;
       break;
@@ -115,8 +122,10 @@ int main(int argc, char *argv[])
   opts.read_or_error(geom, opts.ifile);
 
   int dimension;
-  Status stat = (opts.append_flg) ? geom.add_hull(opts.qh_args, &dimension)
-                                  : geom.set_hull(opts.qh_args, &dimension);
+  Status stat =
+      (opts.append_flg)
+          ? geom.add_hull(opts.qh_args, &dimension, opts.prefilter)
+          : geom.set_hull(opts.qh_args, &dimension, opts.prefilter);
 
   if (stat.is_error())
     opts.error(stat.msg());
@@ -35,8 +35,12 @@
 #include "canonical_common.h"
 #include "color_common.h"
 
+#include <algorithm>
+#include <array>
 #include <cstdio>
+#include <cstring>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 using std::pair;
@@ -1235,6 +1239,7 @@ Options
   -l <lim>  minimum distance change to terminate planarization, as negative
               exponent (default: %d giving %.0e)
             WARNING: high values can cause non-terminal behaviour. Use -i
+  -j <num>  number of threads for planarization (default: %d)
   -o <file> write output to file (default: write to standard output)
 
 Conway Notation Options
@@ -1295,7 +1300,7 @@ keyword: none - sets no color
           prog_name(), help_ver_text,
           it_ctrl.get_status_check_and_report_iters(),
           it_ctrl.get_status_check_only_iters(), it_ctrl.get_sig_digits(),
-          it_ctrl.get_test_val(), it_ctrl.get_max_iters(),
+          it_ctrl.get_test_val(), get_num_threads(), it_ctrl.get_max_iters(),
           TilingColoring::get_option_help('C').c_str());
 }
 
@@ -1314,9 +1319,13 @@ void cn_opts::process_command_line(int argc, char **argv)
   off_color.set_e_col(Color(211, 211, 211)); // lightgray
   off_color.set_v_col(Color(255, 215, 0));   // gold
 
+  // threads only pay for large models, so use one unless set with -j
+  set_num_threads(1);
+
   handle_long_opts(argc, argv);
 
-  while ((c = getopt(argc, argv, ":hHsgtruvc:p:l:i:z:C:V:E:F:T:m:o:")) != -1) {
+  while ((c = getopt(argc, argv, ":hHsgtruvc:p:l:j:i:z:C:V:E:F:T:m:o:")) !=
+         -1) {
     if (common_opts(c, optopt))
       continue;
 
@@ -1430,6 +1439,13 @@ void cn_opts::process_command_line(int argc, char **argv)
       print_status_or_exit(it_ctrl.set_sig_digits(num), c);
       break;
 
+    case 'j':
+      print_status_or_exit(read_int(optarg, &num), c);
+      if (num < 1)
+        error("number of threads must be 1 or more", c);
+      set_num_threads(num);
+      break;
+
     case 'i':
       print_status_or_exit(read_int(optarg, &num), c);
       print_status_or_exit(it_ctrl.set_max_iters(num), c);
@@ -1872,69 +1888,250 @@ void get_seed(Geometry &geom, cn_opts &opts)
 }
 
 // RK - for hart code
-void build_new_faces(map<string, map<string, string>> &faces_table,
-                     map<string, int> verts_table,
-                     vector<vector<int>> &faces_new)
+// The tables of George Hart's algorithms are keyed by names of elements such
+// as "f12" and "3_17". Names are held as integer ids, and are only formatted
+// where the string order of the names gives the order of the output
+class hart_table {
+public:
+  hart_table(int num_corners);
+
+  /// Get the id of a name, adding it if necessary
+  /**\param kind the form of the name: 'f' is fa, 'v' is va, '_' is a_b,
+   *  '~' is a~b and 'c' is afb.
+   * \param a the first number in the name.
+   * \param b the second number in the name, if any.
+   * \return The id of the name. */
+  int node(char kind, int a, int b = 0) { return nodes.get_id({kind, a, b}); }
+
+  /// Get the id of a face name, adding it if necessary
+  /**\param kind the form of the name, as for node().
+   * \param a the first number in the name.
+   * \param b the second number in the name, if any.
+   * \return The id of the face name. */
+  int face(char kind, int a, int b = 0);
+
+  /// Set the vertex number for a name, the same as verts_table[node] = num
+  void set_vert_num(int node, int num);
+
+  /// Set the next name around a face, the same as faces_table[face][node] =
+  /// next
+  void set_next(int face, int node, int next);
+
+  /// Build the faces, in the order of the string keyed tables
+  /**\param faces_new the new faces are added to this. */
+  void build_new_faces(vector<vector<int>> &faces_new) const;
+
+private:
+  struct name {
+    char kind;
+    int a;
+    int b;
+    bool operator==(const name &nm) const
+    {
+      return kind == nm.kind && a == nm.a && b == nm.b;
+    }
+  };
+
+  struct name_hash {
+    size_t operator()(const name &nm) const
+    {
+      size_t h = std::hash<int>()(nm.a);
+      h = h * 1000003 ^ std::hash<int>()(nm.b);
+      return h * 1000003 ^ std::hash<char>()(nm.kind);
+    }
+  };
+
+  class name_ids {
+  public:
+    int get_id(const name &nm);
+    const name &get_name(int id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+    void reserve(size_t sz);
+
+  private:
+    std::unordered_map<name, int, name_hash> ids;
+    vector<name> names;
+  };
+
+  // a name formatted as in the string keyed tables
+  typedef std::array<char, 32> name_str;
+  static void format_name(const name &nm, name_str &str);
+
+  name_ids nodes;
+  name_ids faces;
+  vector<int> vert_nums;                          // by node id, 0 if not set
+  vector<vector<pair<int, int>>> face_next_nodes; // by face id, node to next
+};
+
+hart_table::hart_table(int num_corners)
 {
-  map<string, map<string, string>>::iterator ft;
-  map<string, string>::iterator ftm;
-  string face_name;
-  for (ft = faces_table.begin(); ft != faces_table.end(); ft++) {
-    for (ftm = ft->second.begin(); ftm != ft->second.end(); ftm++) {
-      if (face_name != ft->first) {
-        face_name = ft->first;
-        string v0 = faces_table[face_name][ftm->first];
-        string v = v0;
-        vector<int> face;
-        do {
-          face.push_back(verts_table[v]);
-          v = faces_table[face_name][v];
-        } while (v != v0);
-        if (face.size() > 2) // make sure face is valid
-          faces_new.push_back(face);
-        face.clear();
+  // most names and faces are from corners
+  nodes.reserve(2 * num_corners);
+  faces.reserve(num_corners);
+  face_next_nodes.reserve(num_corners);
+}
+
+void hart_table::name_ids::reserve(size_t sz)
+{
+  ids.reserve(sz);
+  names.reserve(sz);
+}
+
+int hart_table::name_ids::get_id(const name &nm)
+{
+  auto ins = ids.insert(std::make_pair(nm, (int)names.size()));
+  if (ins.second)
+    names.push_back(nm);
+  return ins.first->second;
+}
+
+int hart_table::face(char kind, int a, int b)
+{
+  int id = faces.get_id({kind, a, b});
+  if (id == (int)face_next_nodes.size())
+    face_next_nodes.push_back(vector<pair<int, int>>());
+  return id;
+}
+
+void hart_table::set_vert_num(int node, int num)
+{
+  if (node >= (int)vert_nums.size())
+    vert_nums.resize(nodes.size(), 0);
+  vert_nums[node] = num;
+}
+
+void hart_table::set_next(int face, int node, int next)
+{
+  face_next_nodes[face].push_back(std::make_pair(node, next));
+}
+
+void hart_table::format_name(const name &nm, name_str &str)
+{
+  const char *fmt = "";
+  switch (nm.kind) {
+  case 'f':
+    fmt = "f%d";
+    break;
+  case 'v':
+    fmt = "v%d";
+    break;
+  case '_':
+    fmt = "%d_%d";
+    break;
+  case '~':
+    fmt = "%d~%d";
+    break;
+  case 'c':
+    fmt = "%df%d";
+    break;
+  }
+  // the unused second number is ignored for 'f' and 'v'
+  snprintf(str.data(), str.size(), fmt, nm.a, nm.b);
+}
+
+void hart_table::build_new_faces(vector<vector<int>> &faces_new) const
+{
+  auto get_vert_num = [&](int node) {
+    return (node < (int)vert_nums.size()) ? vert_nums[node] : 0;
+  };
+
+  // faces are taken in the string order of their names
+  vector<name_str> face_strs(faces.size());
+  for (unsigned int i = 0; i < faces.size(); i++)
+    format_name(faces.get_name(i), face_strs[i]);
+  vector<int> face_order(faces.size());
+  for (unsigned int i = 0; i < faces.size(); i++)
+    face_order[i] = i;
+  std::sort(face_order.begin(), face_order.end(), [&](int f1, int f2) {
+    return strcmp(face_strs[f1].data(), face_strs[f2].data()) < 0;
+  });
+
+  faces_new.reserve(faces_new.size() + faces.size());
+  vector<pair<int, int>> next_nodes;
+  vector<int> face;
+  name_str str, first_str;
+  for (int f_idx : face_order) {
+    // a later entry for a name replaces an earlier one
+    next_nodes = face_next_nodes[f_idx];
+    std::stable_sort(
+        next_nodes.begin(), next_nodes.end(),
+        [](const pair<int, int> &a, const pair<int, int> &b) {
+          return a.first < b.first;
+        });
+    unsigned int sz = 0;
+    for (unsigned int i = 0; i < next_nodes.size(); i++) {
+      if (sz && next_nodes[sz - 1].first == next_nodes[i].first)
+        sz--;
+      next_nodes[sz++] = next_nodes[i];
+    }
+    next_nodes.resize(sz);
+
+    // start from the name that follows the first name in string order
+    int first = 0;
+    format_name(nodes.get_name(next_nodes[0].first), first_str);
+    for (unsigned int i = 1; i < next_nodes.size(); i++) {
+      format_name(nodes.get_name(next_nodes[i].first), str);
+      if (strcmp(str.data(), first_str.data()) < 0) {
+        first = i;
+        first_str = str;
       }
     }
+
+    face.clear();
+    int v0 = next_nodes[first].second;
+    int v = v0;
+    do {
+      face.push_back(get_vert_num(v));
+      auto ni = std::lower_bound(
+          next_nodes.begin(), next_nodes.end(), v,
+          [](const pair<int, int> &a, int node) { return a.first < node; });
+      // a broken face never closes, don't add it
+      if (ni == next_nodes.end() || ni->first != v ||
+          face.size() > next_nodes.size()) {
+        face.clear();
+        break;
+      }
+      v = ni->second;
+    } while (v != v0);
+    if (face.size() > 2) // make sure face is valid
+      faces_new.push_back(face);
   }
 }
 
+// number of corners in the faces
+int num_corners(const vector<vector<int>> &faces)
+{
+  int corners = 0;
+  for (const auto &face : faces)
+    corners += face.size();
+  return corners;
+}
+
 // hart_ code ported from George Hart java
 void hart_ambo(Geometry &geom)
 {
-  vector<vector<int>> &faces = geom.raw_faces();
+  const vector<vector<int>> &faces = geom.faces();
   vector<Vec3d> &verts = geom.raw_verts();
 
-  map<string, int> verts_table;
-  map<string, map<string, string>> faces_table;
+  hart_table table(num_corners(faces));
   vector<Vec3d> verts_new;
+  verts_new.reserve(num_corners(faces) / 2);
 
-  string buf1;
-  string buf2;
-  string buf3;
   unsigned int vert_num = 0;
   for (unsigned int i = 0; i < faces.size(); i++) {
     int v1 = faces[i].at(faces[i].size() - 2);
     int v2 = faces[i].at(faces[i].size() - 1);
+    int face_f = table.face('f', i);
     for (unsigned int j = 0; j < faces[i].size(); j++) {
       int v3 = faces[i].at(j);
+      int edge12 = table.node('_', std::min(v1, v2), std::max(v1, v2));
+      int edge23 = table.node('_', std::min(v2, v3), std::max(v2, v3));
       if (v1 < v2) {
-        buf1 = std::to_string((v1 < v2) ? v1 : v2) + "_" +
-               std::to_string((v1 > v2) ? v1 : v2);
-        verts_table[buf1] = vert_num++;
+        table.set_vert_num(edge12, vert_num++);
         verts_new.push_back((verts[v1] + verts[v2]) * 0.5);
       }
-      buf1 = "f" + std::to_string(i);
-      buf2 = std::to_string((v1 < v2) ? v1 : v2) + "_" +
-             std::to_string((v1 > v2) ? v1 : v2);
-      buf3 = std::to_string((v2 < v3) ? v2 : v3) + "_" +
-             std::to_string((v2 > v3) ? v2 : v3);
-      faces_table[buf1][buf2] = buf3;
-      buf1 = "v" + std::to_string(v2);
-      buf2 = std::to_string((v2 < v3) ? v2 : v3) + "_" +
-             std::to_string((v2 > v3) ? v2 : v3);
-      buf3 = std::to_string((v1 < v2) ? v1 : v2) + "_" +
-             std::to_string((v1 > v2) ? v1 : v2);
-      faces_table[buf1][buf2] = buf3;
+      table.set_next(face_f, edge12, edge23);
+      table.set_next(table.face('v', v2), edge23, edge12);
       v1 = v2;
       v2 = v3;
     }
@@ -1944,65 +2141,52 @@ void hart_ambo(Geometry &geom)
   verts = verts_new;
   verts_new.clear();
 
-  build_new_faces(faces_table, verts_table, faces);
-  faces_table.clear();
-  verts_table.clear();
+  table.build_new_faces(geom.raw_faces());
 }
 
 void hart_gyro(Geometry &geom)
 {
-  vector<vector<int>> &faces = geom.raw_faces();
+  const vector<vector<int>> &faces = geom.faces();
   vector<Vec3d> &verts = geom.raw_verts();
 
-  map<string, int> verts_table;
-  map<string, map<string, string>> faces_table;
+  hart_table table(num_corners(faces));
   vector<Vec3d> verts_new;
+  verts_new.reserve(faces.size() + verts.size() + num_corners(faces));
 
-  string buf1;
-  string buf2;
-  string buf3;
   unsigned int vert_num = 0;
   vector<Vec3d> centers;
   geom.face_cents(centers);
   for (unsigned int i = 0; i < faces.size(); i++) {
-    buf1 = "f" + std::to_string(i);
-    verts_table[buf1] = vert_num++;
+    table.set_vert_num(table.node('f', i), vert_num++);
     verts_new.push_back(centers[i].unit());
   }
   centers.clear();
 
   for (unsigned int i = 0; i < verts.size(); i++) {
-    buf1 = "v" + std::to_string(i);
-    verts_table[buf1] = vert_num++;
+    table.set_vert_num(table.node('v', i), vert_num++);
     verts_new.push_back(verts[i]);
   }
 
   for (unsigned int i = 0; i < faces.size(); i++) {
     int v1 = faces[i].at(faces[i].size() - 2);
     int v2 = faces[i].at(faces[i].size() - 1);
+    int cent = table.node('f', i);
     for (unsigned int j = 0; j < faces[i].size(); j++) {
       int v3 = faces[i].at(j);
-      buf1 = std::to_string(v1) + "~" + std::to_string(v2);
-      verts_table[buf1] = vert_num++;
+      int edge12 = table.node('~', v1, v2);
+      int edge21 = table.node('~', v2, v1);
+      int edge23 = table.node('~', v2, v3);
+      int vert2 = table.node('v', v2);
+      table.set_vert_num(edge12, vert_num++);
       // approx. (2/3)v1 + (1/3)v2
       verts_new.push_back(verts[v1] * 0.7 + verts[v2] * 0.3);
 
-      buf1 = std::to_string(i) + "f" + std::to_string(v1);
-      buf2 = "f" + std::to_string(i);
-      buf3 = std::to_string(v1) + "~" + std::to_string(v2);
-      faces_table[buf1][buf2] = buf3;
-      buf2 = std::to_string(v1) + "~" + std::to_string(v2);
-      buf3 = std::to_string(v2) + "~" + std::to_string(v1);
-      faces_table[buf1][buf2] = buf3;
-      buf2 = std::to_string(v2) + "~" + std::to_string(v1);
-      buf3 = "v" + std::to_string(v2);
-      faces_table[buf1][buf2] = buf3;
-      buf2 = "v" + std::to_string(v2);
-      buf3 = std::to_string(v2) + "~" + std::to_string(v3);
-      faces_table[buf1][buf2] = buf3;
-      buf2 = std::to_string(v2) + "~" + std::to_string(v3);
-      buf3 = "f" + std::to_string(i);
-      faces_table[buf1][buf2] = buf3;
+      int face_c = table.face('c', i, v1);
+      table.set_next(face_c, cent, edge12);
+      table.set_next(face_c, edge12, edge21);
+      table.set_next(face_c, edge21, vert2);
+      table.set_next(face_c, vert2, edge23);
+      table.set_next(face_c, edge23, cent);
 
       v1 = v2;
       v2 = v3;
@@ -2013,9 +2197,7 @@ void hart_gyro(Geometry &geom)
   verts = verts_new;
   verts_new.clear();
 
-  build_new_faces(faces_table, verts_table, faces);
-  faces_table.clear();
-  verts_table.clear();
+  table.build_new_faces(geom.raw_faces());
 }
 
 void hart_kisN(Geometry &geom, int n)
@@ -2024,7 +2206,7 @@ void hart_kisN(Geometry &geom, int n)
   if (n < 3)
     n = 0;
 
-  vector<vector<int>> &faces = geom.raw_faces();
+  const vector<vector<int>> &faces = geom.faces();
   vector<Vec3d> &verts = geom.raw_verts();
 
   vector<Vec3d> centers;
@@ -2056,58 +2238,47 @@ void hart_kisN(Geometry &geom, int n)
   centers.clear();
 
   if (faces_new.size() > 0) {
-    faces.clear();
-    faces = faces_new;
+    geom.raw_faces() = faces_new;
     faces_new.clear();
   }
 }
 
 void hart_propellor(Geometry &geom)
 {
-  vector<vector<int>> &faces = geom.raw_faces();
+  const vector<vector<int>> &faces = geom.faces();
   vector<Vec3d> &verts = geom.raw_verts();
 
-  map<string, int> verts_table;
-  map<string, map<string, string>> faces_table;
+  hart_table table(num_corners(faces));
   vector<Vec3d> verts_new;
+  verts_new.reserve(verts.size() + num_corners(faces));
 
-  string buf1;
-  string buf2;
-  string buf3;
   unsigned int vert_num = 0;
   for (unsigned int i = 0; i < verts.size(); i++) {
-    buf1 = "v" + std::to_string(i);
-    verts_table[buf1] = vert_num++;
+    table.set_vert_num(table.node('v', i), vert_num++);
     verts_new.push_back(verts[i].unit());
   }
 
   for (unsigned int i = 0; i < faces.size(); i++) {
     int v1 = faces[i].at(faces[i].size() - 2);
     int v2 = faces[i].at(faces[i].size() - 1);
+    // the central face is named with the face index, as in the Hart code
+    int face_v = table.face('v', i);
     for (unsigned int j = 0; j < faces[i].size(); j++) {
       int v3 = faces[i].at(j);
-      buf1 = std::to_string(v1) + "~" + std::to_string(v2);
-      verts_table[buf1] = vert_num++;
+      int edge12 = table.node('~', v1, v2);
+      int edge21 = table.node('~', v2, v1);
+      int edge23 = table.node('~', v2, v3);
+      int vert2 = table.node('v', v2);
+      table.set_vert_num(edge12, vert_num++);
       // approx. (2/3)v1 + (1/3)v2
       verts_new.push_back(verts[v1] * 0.7 + verts[v2] * 0.3);
 
-      buf1 = "v" + std::to_string(i);
-      buf2 = std::to_string(v1) + "~" + std::to_string(v2);
-      buf3 = std::to_string(v2) + "~" + std::to_string(v3);
-      faces_table[buf1][buf2] = buf3;
-      buf1 = std::to_string(i) + "f" + std::to_string(v2);
-      buf2 = std::to_string(v1) + "~" + std::to_string(v2);
-      buf3 = std::to_string(v2) + "~" + std::to_string(v1);
-      faces_table[buf1][buf2] = buf3;
-      buf2 = std::to_string(v2) + "~" + std::to_string(v1);
-      buf3 = "v" + std::to_string(v2);
-      faces_table[buf1][buf2] = buf3;
-      buf2 = "v" + std::to_string(v2);
-      buf3 = std::to_string(v2) + "~" + std::to_string(v3);
-      faces_table[buf1][buf2] = buf3;
-      buf2 = std::to_string(v2) + "~" + std::to_string(v3);
-      buf3 = std::to_string(v1) + "~" + std::to_string(v2);
-      faces_table[buf1][buf2] = buf3;
+      table.set_next(face_v, edge12, edge23);
+      int face_c = table.face('c', i, v2);
+      table.set_next(face_c, edge12, edge21);
+      table.set_next(face_c, edge21, vert2);
+      table.set_next(face_c, vert2, edge23);
+      table.set_next(face_c, edge23, edge12);
 
       v1 = v2;
       v2 = v3;
@@ -2118,9 +2289,7 @@ void hart_propellor(Geometry &geom)
   verts = verts_new;
   verts_new.clear();
 
-  build_new_faces(faces_table, verts_table, faces);
-  faces_table.clear();
-  verts_table.clear();
+  table.build_new_faces(geom.raw_faces());
 }
 
 /*
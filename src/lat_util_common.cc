@@ -203,10 +203,13 @@ void geom_container_clip(Geometry &geom, Geometry &container,
   trans_m = Trans3d::translate(-container_cent + grid_cent);
   container.transform(trans_m);
 
+  // the container planes are found once, and the points tested in parallel
+  vector<char> included;
+  ConvexContainer(container, eps)
+      .find_included(verts, INCLUSION_IN | INCLUSION_ON, included);
   vector<int> del_verts;
   for (unsigned int i = 0; i < verts.size(); i++) {
-    if (!are_points_in_hull(as_vector(verts[i]), container,
-                            INCLUSION_IN | INCLUSION_ON, eps))
+    if (!included[i])
       del_verts.push_back(i);
   }
 
@@ -387,11 +390,15 @@ void add_color_struts(Geometry &geom, const double len2, Color &edge_col,
 {
   const vector<Vec3d> &verts = geom.verts();
 
-  for (unsigned int i = 0; i < verts.size(); i++)
-    for (unsigned int j = i; j < verts.size(); j++) {
-      if (fabs((verts[i] - verts[j]).len2() - len2) < eps)
+  // only vertices within the strut length are tested
+  PointIndex vert_index(verts, sqrt(len2 + eps));
+  vector<int> strut_ends;
+  for (unsigned int i = 0; i < verts.size(); i++) {
+    vert_index.find_in_shell(verts[i], len2, eps, strut_ends);
+    for (int j : strut_ends)
+      if (j >= (int)i)
         geom.add_edge(make_edge(i, j), edge_col);
-    }
+  }
 }
 
 void color_centroid(Geometry &geom, Color &cent_col, const double eps)
@@ -425,19 +432,20 @@ int get_voronoi_geom(Geometry &geom, Geometry &vgeom, const bool central_cells,
   }
   hgeom.orient(1); // positive orientation
 
-  // Add centroid to a vector. Needed in this form for are_points_in_hull()
-  vector<Vec3d> cent = as_vector(centroid(hgeom.verts()));
+  // the hull planes are found once for testing all the cells
+  ConvexContainer hull_container(hgeom, eps);
+  const bool cent_in_hull = hull_container.includes(
+      centroid(hgeom.verts()), INCLUSION_IN | INCLUSION_ON);
 
   vector<Geometry> cells;
   get_voronoi_cells(geom.verts(), &cells);
 
   for (auto &cell : cells) {
-    if (central_cells &&
-        !are_points_in_hull(cent, hgeom, INCLUSION_IN | INCLUSION_ON, eps)) {
+    if (central_cells && !cent_in_hull) {
       continue;
     }
-    else if (!are_points_in_hull(cell.verts(), hgeom,
-                                 INCLUSION_IN | INCLUSION_ON, eps)) {
+    else if (!hull_container.includes(cell.verts(),
+                                      INCLUSION_IN | INCLUSION_ON)) {
       continue;
     }
     vgeom.append(cell);
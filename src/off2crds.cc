@@ -48,7 +48,10 @@ public:
   string ifile;
   string ofile;
 
-  o2c_opts() : ProgramOpts("off2crds"), sep(" "), sig_digits(DEF_SIG_DGTS) {}
+  o2c_opts()
+      : ProgramOpts("off2crds", false), sep(" "), sig_digits(DEF_SIG_DGTS)
+  {
+  }
   void process_command_line(int argc, char **argv);
   void usage();
 };
@@ -50,7 +50,7 @@ public:
   string sep = " ";              // seperator
   int sig_digits = DEF_SIG_DGTS; // significant digits output (system default)
 
-  o2o_opts() : ProgramOpts("off2obj") {}
+  o2o_opts() : ProgramOpts("off2obj", false) {}
 
   void process_command_line(int argc, char **argv);
   void usage();
@@ -64,7 +64,7 @@ public:
   string ofile;
 
   oq_opts()
-      : ProgramOpts("off_query"), center(Vec3d(0, 0, 0)),
+      : ProgramOpts("off_query", false), center(Vec3d(0, 0, 0)),
         center_is_centroid(false), sig_digits(17), orient(true), edge_type('a')
   {
   }
@@ -60,7 +60,7 @@ public:
   string ofile;
 
   or_opts()
-      : ProgramOpts("off_report"), center(Vec3d(0, 0, 0)),
+      : ProgramOpts("off_report", false), center(Vec3d(0, 0, 0)),
         center_is_centroid(false), sig_digits(17), orient(true),
         detect_symmetry(false), edge_type('a')
   {
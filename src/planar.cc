@@ -33,8 +33,10 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <limits>
 #include <map>
 #include <string>
 #include <vector>
@@ -567,24 +569,53 @@ vector<vector<int>> on_same_plane_filter(const Geometry &geom,
     return coplanar_faces_filtered;
   }
 
+  // faces are on the same plane if their offsets along the normal are within
+  // eps. Only faces with a close offset are tested, the test is unchanged.
+  // A face with an offset that isn't finite is never on another's plane.
+  unsigned int sz = coplanar_faces.size();
+  vector<pair<double, int>> offsets;
+  double max_len = 0.0;
+  for (unsigned int i = 0; i < sz; i++) {
+    const Vec3d &v0 = verts[faces[coplanar_faces[i]][0]];
+    double offset = vdot(v0, normal);
+    if (std::isfinite(offset)) {
+      offsets.push_back(make_pair(offset, i));
+      max_len = max(max_len, v0.len());
+    }
+  }
+  sort(offsets.begin(), offsets.end());
+  // allow for rounding differences between the offset and the test
+  const double margin =
+      2 * eps + 16 * std::numeric_limits<double>::epsilon() * max_len;
+
   vector<int> coplanar_faces_actual;
-  vector<int> written;
+  vector<bool> written(sz, false);
+  vector<int> near_faces;
 
-  unsigned int sz = coplanar_faces.size();
   for (unsigned int i = 0; i < sz; i++) {
-    int face_idx1 = coplanar_faces[i];
-    if (find(written.begin(), written.end(), face_idx1) != written.end())
+    if (written[i])
       continue;
+    int face_idx1 = coplanar_faces[i];
     coplanar_faces_actual.push_back(face_idx1);
-    for (unsigned int j = i + 1; j < sz; j++) {
-      if (i == j)
-        continue;
+
+    Vec3d v0 = verts[faces[face_idx1][0]];
+    double offset = vdot(v0, normal);
+    near_faces.clear();
+    if (std::isfinite(offset)) {
+      auto oi = lower_bound(offsets.begin(), offsets.end(),
+                            make_pair(offset - margin, -1));
+      for (; oi != offsets.end() && oi->first <= offset + margin; ++oi)
+        if (oi->second > (int)i)
+          near_faces.push_back(oi->second);
+      sort(near_faces.begin(), near_faces.end());
+    }
+
+    for (int j : near_faces) {
       int face_idx2 = coplanar_faces[j];
-      Vec3d v0 = verts[faces[face_idx1][0]];
       Vec3d P = verts[faces[face_idx2][0]];
       if (double_eq(vdot(v0 - P, normal), 0.0, eps)) {
         coplanar_faces_actual.push_back(face_idx2);
-        written.push_back(face_idx2);
+        written[j] = true;
       }
     }
 
@@ -595,6 +626,22 @@ vector<vector<int>> on_same_plane_filter(const Geometry &geom,
   return coplanar_faces_filtered;
 }
 
+// reverse a normal if it is opposite to an earlier one, earlier normals
+// are taken in order, and with any reversal they have had.
+void fold_normal_table(vector<pair<Vec3d, int>> &normal_table,
+                       const double eps)
+{
+  PointIndex normal_index(4 * eps);
+  for (auto &normal_pair : normal_table) {
+    Vec3d &normal = normal_pair.first;
+    // after a reversal only later normals can reverse it again
+    int i = -1;
+    while ((i = normal_index.find_coincident(-normal, eps, i)) != -1)
+      normal = -normal;
+    normal_index.add(normal);
+  }
+}
+
 void build_coplanar_faces_list(const Geometry &geom,
                                vector<vector<int>> &coplanar_faces_list,
                                vector<Normal> &coplanar_normals,
@@ -632,16 +679,8 @@ void build_coplanar_faces_list(const Geometry &geom,
   // hemispherical normals are folded only with specific option
   // if folded, this is what associates them on the same plane
   unsigned int sz = hemispherical_table.size();
-  if (fold_normals_hemispherical && (sz > 1)) {
-    for (unsigned int i = 0; i < sz - 1; i++) {
-      for (unsigned int j = i + 1; j < sz; j++) {
-        if (!compare(hemispherical_table[i].first,
-                     -hemispherical_table[j].first, eps)) {
-          hemispherical_table[j].first = -hemispherical_table[j].first;
-        }
-      }
-    }
-  }
+  if (fold_normals_hemispherical && (sz > 1))
+    fold_normal_table(hemispherical_table, eps);
 
   // collect hemispherical which are coplanar
   if (sz) {
@@ -678,16 +717,8 @@ void build_coplanar_faces_list(const Geometry &geom,
 
   // non-hemispherical normals are folded only with specific option
   sz = face_normal_table.size();
-  if (fold_normals && (sz > 1)) {
-    for (unsigned int i = 0; i < sz - 1; i++) {
-      for (unsigned int j = i + 1; j < sz; j++) {
-        if (!compare(face_normal_table[i].first, -face_normal_table[j].first,
-                     eps)) {
-          face_normal_table[j].first = -face_normal_table[j].first;
-        }
-      }
-    }
-  }
+  if (fold_normals && (sz > 1))
+    fold_normal_table(face_normal_table, eps);
 
   // collect non-hemispherical which are coplanar
   if (sz) {
@@ -1213,6 +1244,96 @@ int intersection_is_end_point(const Vec3d &intersection_point, const Vec3d &P0,
   return which_one;
 }
 
+// Uniform grid over the vertices of a coplanar group, on the two coordinates
+// with the largest extent, for finding the vertices that lie in a box
+class vert_grid {
+public:
+  vert_grid(const vector<Vec3d> &verts, unsigned int num_verts);
+  void find_in_box(const Vec3d &lo, const Vec3d &hi, vector<int> &idxs) const;
+
+private:
+  int axes[2];          // coordinates that are indexed
+  double origin[2];     // lowest coordinate values
+  double cell_size;     // side of a square cell
+  int dims[2];          // number of cells along each indexed coordinate
+  vector<int> starts;   // start of each cell in cell_verts, and the end
+  vector<int> cell_verts;
+
+  int get_cell_idx(double coord, int i) const;
+};
+
+vert_grid::vert_grid(const vector<Vec3d> &verts, unsigned int num_verts)
+{
+  vector<int> idxs;
+  vector<Vec3d> finite_verts;
+  for (unsigned int i = 0; i < num_verts; i++) {
+    const Vec3d &v = verts[i];
+    // a vertex that is not finite is never on a segment
+    if (v.is_set() && std::isfinite(v[0]) && std::isfinite(v[1]) &&
+        std::isfinite(v[2])) {
+      finite_verts.push_back(v);
+      idxs.push_back(i);
+    }
+  }
+  BoundBox bb(finite_verts);
+
+  // index on the two coordinates with the largest extent
+  Vec3d ext = idxs.size() ? bb.get_max() - bb.get_min() : Vec3d::zero;
+  int drop = 0;
+  for (int i = 1; i < 3; i++)
+    if (ext[i] < ext[drop])
+      drop = i;
+  axes[0] = (drop + 1) % 3;
+  axes[1] = (drop + 2) % 3;
+
+  // about one vertex per cell if the vertices are spread evenly
+  const double max_ext = std::max(ext[axes[0]], ext[axes[1]]);
+  const int side_cells = (int)ceil(sqrt((double)idxs.size()));
+  cell_size = (max_ext > 0.0) ? max_ext / std::max(side_cells, 1) : 1.0;
+  for (int i = 0; i < 2; i++) {
+    origin[i] = idxs.size() ? bb.get_min()[axes[i]] : 0.0;
+    dims[i] = std::min((int)(ext[axes[i]] / cell_size), side_cells) + 1;
+  }
+
+  // vertices are held in cell order, the cell of each is found twice
+  starts.assign(dims[0] * dims[1] + 1, 0);
+  auto cell_of = [&](int v_idx) {
+    return get_cell_idx(verts[v_idx][axes[1]], 1) * dims[0] +
+           get_cell_idx(verts[v_idx][axes[0]], 0);
+  };
+  for (int idx : idxs)
+    starts[cell_of(idx) + 1]++;
+  for (unsigned int c = 1; c < starts.size(); c++)
+    starts[c] += starts[c - 1];
+  cell_verts.resize(idxs.size());
+  vector<int> fill(starts.begin(), starts.end() - 1);
+  for (int idx : idxs)
+    cell_verts[fill[cell_of(idx)]++] = idx;
+}
+
+int vert_grid::get_cell_idx(double coord, int i) const
+{
+  const double cell = floor((coord - origin[i]) / cell_size);
+  return (int)std::max(0.0, std::min((double)dims[i] - 1, cell));
+}
+
+void vert_grid::find_in_box(const Vec3d &lo, const Vec3d &hi,
+                            vector<int> &idxs) const
+{
+  idxs.clear();
+  int lo_idx[2], hi_idx[2];
+  for (int i = 0; i < 2; i++) {
+    lo_idx[i] = get_cell_idx(lo[axes[i]], i);
+    hi_idx[i] = get_cell_idx(hi[axes[i]], i);
+  }
+  for (int y = lo_idx[1]; y <= hi_idx[1]; y++)
+    for (int x = lo_idx[0]; x <= hi_idx[0]; x++) {
+      const int c = y * dims[0] + x;
+      idxs.insert(idxs.end(), cell_verts.begin() + starts[c],
+                  cell_verts.begin() + starts[c + 1]);
+    }
+}
+
 // anywhere a vertex is on an edge, split that edge
 bool mesh_verts(Geometry &geom, const double eps)
 {
@@ -1223,6 +1344,15 @@ bool mesh_verts(Geometry &geom, const double eps)
   unsigned int vsz = verts.size();
   unsigned int esz = edges.size();
 
+  // only vertices near an edge are tested, and new edges are looked up in
+  // the edge index of the geometry, with the same result as edge_into_geom
+  const vert_grid grid(verts, vsz);
+  vector<int> near_verts;
+  auto add_edgelet = [&](int v_idx1, int v_idx2) {
+    if (v_idx1 != v_idx2 && geom.find_edge(v_idx1, v_idx2) < 0)
+      geom.add_edge(make_edge(v_idx1, v_idx2), Color::invisible);
+  };
+
   vector<int> deleted_edges;
 
   // compare only existing edges and verts
@@ -1230,9 +1360,29 @@ bool mesh_verts(Geometry &geom, const double eps)
     vector<pair<double, int>> line_intersections;
     Vec3d Q0 = verts[edges[i][0]];
     Vec3d Q1 = verts[edges[i][1]];
-    for (unsigned int v_idx = 0; v_idx < vsz; v_idx++) {
+
+    // point_in_segment() accepts a point within eps of the line through
+    // Q0,Q1 if in_segment() accepts its nearest point. That compares
+    // coordinates in order, the first coordinate that varies by eps along
+    // the edge limits how far past the ends the nearest point can be.
+    const Vec3d diff = Q1 - Q0;
+    double past_ends = 0.0; // as a fraction of the edge
+    for (int k = 0; k < 3; k++)
+      if (fabs(diff[k]) >= eps) {
+        past_ends = 2 * eps / fabs(diff[k]);
+        break;
+      }
+    Vec3d lo, hi;
+    for (int k = 0; k < 3; k++) {
+      const double margin = 3 * eps + fabs(diff[k]) * past_ends;
+      lo[k] = std::min(Q0[k], Q1[k]) - margin;
+      hi[k] = std::max(Q0[k], Q1[k]) + margin;
+    }
+    grid.find_in_box(lo, hi, near_verts);
+
+    for (int v_idx : near_verts) {
       // don't compare to self
-      if (edges[i][0] == (int)v_idx || edges[i][1] == (int)v_idx)
+      if (edges[i][0] == v_idx || edges[i][1] == v_idx)
         continue;
 
       // find if P is in Q0,Q1
@@ -1252,14 +1402,12 @@ bool mesh_verts(Geometry &geom, const double eps)
       sort(line_intersections.begin(), line_intersections.end());
       // create edgelets from Q0 through intersection points to Q1 (using
       // indexes)
-      edge_into_geom(geom, edges[i][0], line_intersections[0].second,
-                     Color::invisible);
+      add_edgelet(edges[i][0], line_intersections[0].second);
       for (unsigned int k = 0; k < line_intersections.size() - 1; k++)
-        edge_into_geom(geom, line_intersections[k].second,
-                       line_intersections[k + 1].second, Color::invisible);
-      edge_into_geom(geom,
-                     line_intersections[line_intersections.size() - 1].second,
-                     edges[i][1], Color::invisible);
+        add_edgelet(line_intersections[k].second,
+                    line_intersections[k + 1].second);
+      add_edgelet(line_intersections[line_intersections.size() - 1].second,
+                  edges[i][1]);
     }
   }
 
@@ -1674,6 +1822,11 @@ void blend_overlapping_faces(Geometry &geom, vector<int> &winding_numbers,
   Geometry bgeom;
   vector<int> deleted_faces;
 
+  // edges with duplicate indexes can happen if faces have duplicate
+  // sequential indexes. geom doesn't change in the loop, so only once
+  if (coplanar_faces_list.size())
+    delete_duplicate_index_edges(geom);
+
   for (unsigned int i = 0; i < coplanar_faces_list.size(); i++) {
     // load a geom with color faces. keep it and copy it.
     Geometry cgeom = faces_to_geom(geom, coplanar_faces_list[i]);
@@ -1692,10 +1845,6 @@ void blend_overlapping_faces(Geometry &geom, vector<int> &winding_numbers,
 
     make_skeleton(sgeom);
 
-    // edges with duplicate indexes can happen if faces have duplicate
-    // sequential indexes
-    delete_duplicate_index_edges(geom);
-
     if (connectors.size())
       add_hole_connectors(sgeom, connectors);
     connectors.clear();
@@ -1846,8 +1995,10 @@ vector<int> find_end_points_vertex(const Geometry &geom,
   const vector<Vec3d> &verts = geom.verts();
 
   Geometry vgeom;
+  PointIndex vert_index(4 * eps);
   for (int vert_indexe : vert_indexes)
-    vertex_into_geom(vgeom, verts[vert_indexe], Color::invisible, eps);
+    vertex_into_geom(vgeom, vert_index, verts[vert_indexe], Color::invisible,
+                     eps);
   vgeom.set_hull();
 
   const vector<Vec3d> &gverts = vgeom.verts();
@@ -1943,14 +2094,13 @@ void insert_verts_into_face(Geometry &geom, vector<int> &added_vertices,
                             const int face_idx, const int start_v_idx,
                             const int end_v_idx)
 {
-  vector<vector<int>> &faces = geom.raw_faces();
-  auto iter1 =
-      find(faces[face_idx].begin(), faces[face_idx].end(), start_v_idx);
-  auto iter2 = find(faces[face_idx].begin(), faces[face_idx].end(), end_v_idx);
+  vector<int> &face = geom.faces_mut(face_idx);
+  auto iter1 = find(face.begin(), face.end(), start_v_idx);
+  auto iter2 = find(face.begin(), face.end(), end_v_idx);
 
   // this is how the first and last element is designated
-  auto first = faces[face_idx].begin();
-  auto last = faces[face_idx].end();
+  auto first = face.begin();
+  auto last = face.end();
   last--;
 
   if (!(*first == end_v_idx && *last == start_v_idx) &&
@@ -1959,8 +2109,7 @@ void insert_verts_into_face(Geometry &geom, vector<int> &added_vertices,
     reverse(added_vertices.begin(), added_vertices.end());
   }
 
-  faces[face_idx].insert((iter1 + 1), added_vertices.begin(),
-                         added_vertices.end());
+  face.insert((iter1 + 1), added_vertices.begin(), added_vertices.end());
 }
 
 // adds vertices to faces on seams where there is a mismatch in vertices from
@@ -1974,24 +2123,28 @@ void stitch_faces_on_seams(Geometry &geom, const double eps)
   vector<vector<int>> colinear_vertex_list;
   build_colinear_vertex_list(geom, colinear_vertex_list, eps);
 
-  // find what vertices are in faces
-  vector<vector<int>> vert_has_faces;
-  for (unsigned int i = 0; i < verts.size(); i++)
-    vert_has_faces.push_back(find_faces_with_vertex(faces, i));
+  // find what vertices are in faces, face indexes are listed in order
+  vector<vector<int>> vert_has_faces(verts.size());
+  for (unsigned int i = 0; i < faces.size(); i++)
+    for (int v_idx : faces[i]) {
+      vector<int> &v_faces = vert_has_faces[v_idx];
+      if (v_faces.empty() || v_faces.back() != (int)i)
+        v_faces.push_back(i);
+    }
 
   for (auto colinear_verts : colinear_vertex_list) {
     unsigned int sz = colinear_verts.size();
     // if there are only two verts there can be no face between them
     for (unsigned int j = 0; j < sz - 2; j++) {
       int start_v_idx = colinear_verts[j];
-      vector<int> vert_has_faces_start = vert_has_faces[start_v_idx];
+      const vector<int> &vert_has_faces_start = vert_has_faces[start_v_idx];
       for (int face_idx : vert_has_faces_start) {
         vector<int> added_vertices;
         for (unsigned int l = j + 1; l < sz; l++) {
           int test_v_idx = colinear_verts[l];
-          vector<int> vert_has_faces_test = vert_has_faces[test_v_idx];
-          if (find(vert_has_faces_test.begin(), vert_has_faces_test.end(),
-                   face_idx) == vert_has_faces_test.end()) {
+          const vector<int> &vert_has_faces_test = vert_has_faces[test_v_idx];
+          if (!std::binary_search(vert_has_faces_test.begin(),
+                                  vert_has_faces_test.end(), face_idx)) {
             added_vertices.push_back(test_v_idx);
           }
           else {
@@ -2030,7 +2183,7 @@ void remove_in_line_vertices(Geometry &geom, const double eps)
 
   vector<int> deleted_verts;
   for (unsigned int i = 0; i < verts.size(); i++) {
-    if (find(end_points.begin(), end_points.end(), i) == end_points.end())
+    if (!std::binary_search(end_points.begin(), end_points.end(), (int)i))
       deleted_verts.push_back(i);
   }
   end_points.clear();
@@ -392,8 +392,7 @@ Status make_equal_edges(Geometry &base_geom, IterationControl it_ctrl,
 
     if (using_symmetry) {
       // Ensure that the vertices used in adjustment are up to date
-      for (auto v_idx : verts_to_update)
-        sym_updater.update_from_principal_vertex(v_idx);
+      sym_updater.update_from_principal_verts(verts_to_update);
     }
 
     max_dist = 0;
@@ -531,8 +530,7 @@ Status make_regular_faces(Geometry &base_geom, IterationControl it_ctrl,
 
     if (using_symmetry) {
       // Ensure that the vertices used in adjustment are up to date
-      for (int v_idx : verts_to_update)
-        sym_updater.update_from_principal_vertex(v_idx);
+      sym_updater.update_from_principal_verts(verts_to_update);
     }
 
     for (int f_idx : faces_to_process) {
@@ -30,6 +30,7 @@
 
 #include "../base/antiprism.h"
 
+#include <algorithm>
 #include <cctype>
 #include <cmath>
 #include <cstdlib>
@@ -49,6 +50,8 @@ public:
   int num_pts = -1;
   double repel_formula_exp = 2;
   double shorten_by = -1;
+  double open_angle = 0; // exact forces
+  int num_threads = 0;   // default
 
   string ifile;
   string ofile;
@@ -74,7 +77,9 @@ Usage: %s [options] [input_file]
 
 An equilibrium position is found for a set of points which repel each
 other. The initial coordinates are read from input_file if given (or
-from standard input), otherwise use -N to generate a random set.
+from standard input), otherwise use -N to generate a random set. A point
+with an index colour repels with a strength of the index number, other
+points have a strength of 1.
 
 Options
 %s
@@ -82,6 +87,12 @@ Options
   -n <itrs> maximum number of iterations, -1 for unlimited (default: %d)
   -s <perc> percentage to shorten the travel distance (default: adaptive)
   -r <exp>  repelling formula, 1/distance^exp (default: 2)
+  -a <ang>  approximate the forces from distant groups of points with an
+            octree, ang is the opening angle, the largest ratio of group
+            width to distance for a group to be treated as a single point
+            (e.g. 0.5, larger is faster and less accurate), 0 to calculate
+            all forces exactly (default: 0)
+  -j <num>  number of threads for calculating forces (default: %d)
   -l <lim>  minimum change of distance/width_of_model to terminate, as 
                negative exponent (default: %d giving %.0e)
   -z <nums> number of iterations between status reports (implies termination
@@ -92,7 +103,7 @@ Options
 
 )",
           prog_name(), help_ver_text, it_ctrl.get_max_iters(),
-          it_ctrl.get_sig_digits(), it_ctrl.get_test_val(),
+          get_num_threads(), it_ctrl.get_sig_digits(), it_ctrl.get_test_val(),
           it_ctrl.get_status_check_and_report_iters(),
           it_ctrl.get_status_check_only_iters());
 }
@@ -106,7 +117,7 @@ void rep_opts::process_command_line(int argc, char **argv)
 
   handle_long_opts(argc, argv);
 
-  while ((c = getopt(argc, argv, ":hn:z:N:s:l:r:o:")) != -1) {
+  while ((c = getopt(argc, argv, ":hn:z:N:s:l:r:a:j:o:")) != -1) {
     if (common_opts(c, optopt))
       continue;
 
@@ -145,6 +156,18 @@ void rep_opts::process_command_line(int argc, char **argv)
                 c);
       break;
 
+    case 'a':
+      print_status_or_exit(read_double(optarg, &open_angle), c);
+      if (open_angle < 0)
+        error("opening angle cannot be negative", c);
+      break;
+
+    case 'j':
+      print_status_or_exit(read_int(optarg, &num_threads), c);
+      if (num_threads < 1)
+        error("number of threads must be 1 or more", c);
+      break;
+
     case 'o':
       ofile = optarg;
       break;
@@ -174,6 +197,147 @@ Vec3d repel_inv_dist_exp(Vec3d v1, Vec3d v2, double exp)
   return v2.with_len(len);
 }
 
+// Octree of weighted points, used to approximate the forces from distant
+// groups of points by the force from their weighted centre (Barnes-Hut)
+class RepelTree {
+private:
+  struct Node {
+    Vec3d cent;      // centre of the node cube
+    double width;    // width of the node cube
+    Vec3d wt_cent;   // weighted centre of the points
+    double wt;       // sum of the point weights
+    int start;       // first point, index into pt_idxs
+    int end;         // one past the last point
+    int child_start; // index of first child, or -1 for a leaf
+    int num_children;
+  };
+
+  const vector<Vec3d> &pts;
+  const vector<double> &wts;
+  vector<Node> nodes;
+  vector<int> pt_idxs; // point indexes, each node's points are contiguous
+  vector<int> pt_pos;  // position of each point in pt_idxs
+
+  static const int leaf_size = 8;
+  static const int max_depth = 32;
+
+  void split(int node_idx, int depth);
+
+public:
+  RepelTree(const vector<Vec3d> &pts, const vector<double> &wts);
+
+  /// Get the force on a point from all the other points
+  /**\param idx index of the point.
+   * \param exponent repelling formula exponent.
+   * \param open_angle largest ratio of node width to distance for the
+   *  points of the node to be treated as a single point.
+   * \return The force. */
+  Vec3d get_force(int idx, double exponent, double open_angle) const;
+};
+
+RepelTree::RepelTree(const vector<Vec3d> &pts, const vector<double> &wts)
+    : pts(pts), wts(wts)
+{
+  const int num = pts.size();
+  pt_idxs.resize(num);
+  for (int i = 0; i < num; i++)
+    pt_idxs[i] = i;
+
+  BoundBox bbox(pts);
+  const Vec3d cent = bbox.get_centre();
+  const Vec3d diag = bbox.get_max() - bbox.get_min();
+  const double width = std::max(std::max(diag[0], diag[1]), diag[2]);
+  nodes.push_back({cent, width, Vec3d::zero, 0, 0, num, -1, 0});
+  split(0, 0);
+
+  pt_pos.resize(num);
+  for (int i = 0; i < num; i++)
+    pt_pos[pt_idxs[i]] = i;
+}
+
+void RepelTree::split(int node_idx, int depth)
+{
+  Node node = nodes[node_idx];
+
+  // Sort points into octants, keeping their order within each octant
+  if (node.end - node.start > leaf_size && depth < max_depth) {
+    vector<int> octant_idxs[8];
+    for (int i = node.start; i < node.end; i++) {
+      const Vec3d &pt = pts[pt_idxs[i]];
+      const int oct = (pt[0] > node.cent[0]) + 2 * (pt[1] > node.cent[1]) +
+                      4 * (pt[2] > node.cent[2]);
+      octant_idxs[oct].push_back(pt_idxs[i]);
+    }
+
+    node.child_start = nodes.size();
+    int pos = node.start;
+    for (int oct = 0; oct < 8; oct++) {
+      if (octant_idxs[oct].empty())
+        continue;
+      const double w = node.width / 2;
+      const Vec3d cent = node.cent + Vec3d((oct & 1) ? w / 2 : -w / 2,
+                                           (oct & 2) ? w / 2 : -w / 2,
+                                           (oct & 4) ? w / 2 : -w / 2);
+      std::copy(octant_idxs[oct].begin(), octant_idxs[oct].end(),
+                pt_idxs.begin() + pos);
+      const int end = pos + octant_idxs[oct].size();
+      nodes.push_back({cent, w, Vec3d::zero, 0, pos, end, -1, 0});
+      node.num_children++;
+      pos = end;
+    }
+
+    for (int i = 0; i < node.num_children; i++) {
+      const int child_idx = node.child_start + i;
+      split(child_idx, depth + 1);
+      node.wt += nodes[child_idx].wt;
+      node.wt_cent += nodes[child_idx].wt_cent * nodes[child_idx].wt;
+    }
+  }
+  else {
+    for (int i = node.start; i < node.end; i++) {
+      node.wt += wts[pt_idxs[i]];
+      node.wt_cent += pts[pt_idxs[i]] * wts[pt_idxs[i]];
+    }
+  }
+
+  if (node.wt)
+    node.wt_cent /= node.wt;
+  nodes[node_idx] = node;
+}
+
+Vec3d RepelTree::get_force(int idx, double exponent, double open_angle) const
+{
+  const Vec3d &pt = pts[idx];
+  const int pos = pt_pos[idx];
+  Vec3d force = Vec3d::zero;
+  vector<int> stack(1, 0);
+  while (!stack.empty()) {
+    const Node &node = nodes[stack.back()];
+    stack.pop_back();
+    if (!node.wt)
+      continue;
+
+    const bool contains_pt = (pos >= node.start && pos < node.end);
+    if (!contains_pt &&
+        node.width < open_angle * (node.wt_cent - pt).len()) {
+      force -= repel_inv_dist_exp(pt, node.wt_cent, exponent) * node.wt;
+    }
+    else if (node.child_start < 0) {
+      for (int i = node.start; i < node.end; i++)
+        if (pt_idxs[i] != idx)
+          force -= repel_inv_dist_exp(pt, pts[pt_idxs[i]], exponent) *
+                   wts[pt_idxs[i]];
+    }
+    else {
+      // push in reverse so children are visited in order
+      for (int i = node.num_children - 1; i >= 0; i--)
+        stack.push_back(node.child_start + i);
+    }
+  }
+
+  return force;
+}
+
 void random_placement(Geometry &geom, int n)
 {
   geom.clear_all();
@@ -184,10 +348,10 @@ void random_placement(Geometry &geom, int n)
 }
 
 void repel(Geometry &geom, IterationControl it_ctrl, double exponent,
-           double shorten_factor)
+           double shorten_factor, double open_angle)
 {
   const int v_sz = geom.verts().size();
-  vector<int> wts(v_sz);
+  vector<double> wts(v_sz);
   for (int i = 0; i < v_sz; i++) {
     Color col = geom.colors(VERTS).get(i);
     wts[i] = col.is_index() ? col.get_index() : 1;
@@ -210,13 +374,54 @@ void repel(Geometry &geom, IterationControl it_ctrl, double exponent,
     std::fill(offsets.begin(), offsets.end(), Vec3d::zero);
     max_dist2 = 0;
 
-    for (int i = 0; i < v_sz - 1; i++) {
-      for (int j = i + 1; j < v_sz; j++) {
-        Vec3d offset =
-            repel_inv_dist_exp(geom.verts(i), geom.verts(j), exponent);
-        offsets[i] -= offset;
-        offsets[j] += offset;
+    if (open_angle > 0) {
+      // each force is found independently, with the same result for any
+      // number of threads. A force visits many tree nodes, so a block
+      // needs only a few vertices
+      const RepelTree tree(geom.verts(), wts);
+      parallel_for(
+          v_sz,
+          [&](int start, int end, int) {
+            for (int i = start; i < end; i++)
+              offsets[i] = tree.get_force(i, exponent, open_angle);
+          },
+          0, 64);
+    }
+    else {
+      // each block of rows accumulates into its own offsets, which are
+      // summed in block order. The rows get shorter, so the blocks are
+      // chosen to have a similar number of pairs
+      const int grain = std::max(DEF_PARALLEL_GRAIN / (v_sz + 1), 1);
+      const int num_blks = std::max(parallel_blocks(v_sz, 0, grain), 1);
+      vector<int> blk_starts(num_blks + 1, v_sz);
+      const double num_pairs = 0.5 * v_sz * (v_sz - 1.0);
+      for (int b = 0, i = 0; b < num_blks; b++) {
+        blk_starts[b] = i;
+        while (i < v_sz &&
+               i * (v_sz - (i + 1) / 2.0) < num_pairs * (b + 1) / num_blks)
+          i++;
       }
+      vector<vector<Vec3d>> blk_offsets(num_blks - 1,
+                                        vector<Vec3d>(v_sz, Vec3d::zero));
+      parallel_for(
+          num_blks,
+          [&](int start, int end, int) {
+            for (int blk = start; blk < end; blk++) {
+              vector<Vec3d> &offs = blk ? blk_offsets[blk - 1] : offsets;
+              for (int i = blk_starts[blk]; i < blk_starts[blk + 1]; i++) {
+                for (int j = i + 1; j < v_sz; j++) {
+                  Vec3d offset = repel_inv_dist_exp(geom.verts(i),
+                                                    geom.verts(j), exponent);
+                  offs[i] -= offset * wts[j];
+                  offs[j] += offset * wts[i];
+                }
+              }
+            }
+          },
+          num_blks, 1);
+      for (auto &offs : blk_offsets)
+        for (int i = 0; i < v_sz; i++)
+          offsets[i] += offs[i];
     }
 
     for (int i = 0; i < v_sz; i++) {
@@ -297,7 +502,10 @@ int main(int argc, char *argv[])
   else
     opts.read_or_error(geom, opts.ifile);
 
-  repel(geom, opts.it_ctrl, opts.repel_formula_exp, opts.shorten_by / 100);
+  if (opts.num_threads)
+    set_num_threads(opts.num_threads);
+  repel(geom, opts.it_ctrl, opts.repel_formula_exp, opts.shorten_by / 100,
+        opts.open_angle);
 
   opts.write_or_error(geom, opts.ofile);
 
@@ -32,6 +32,7 @@
 #include "color_common.h"
 #include "lat_util_common.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib> // avoid ambiguities with std::abs(long) on OSX
 #include <string>
@@ -81,6 +82,7 @@ public:
   int method = 1;             // 1 - sphere-ray intersection  2 - z guess
   long scale = 0;             // for precision
   bool tester_defeat = false; // turn off computation testing for method 1
+  char stream = '\0';         // stream surface points for method 1
 
   bool convex_hull = true; // do convex hull of result
   bool add_hull = false;   // add lattice to convex hull
@@ -125,6 +127,12 @@ Program Options
   -M <mthd> 1 - sphere-ray intersection  2 - z guess (default: 1)
   -f        fill interior points (not for -C c)
   -t        defeat computational error testing for sphere-ray method
+  -S <mode> stream the surface points for the sphere-ray method, rather than
+            holding them all before the convex hull
+              h - keep only the convex hull of the points found so far
+                  (only with -C c)
+              c - write the points to the output file as coordinates as
+                  they are found (no convex hull, coloring or --binary)
 
 Scene Options
   -C <opt>  c - convex hull only, i - keep interior, s - suppress (default: c)
@@ -181,7 +189,7 @@ void waterman_opts::process_command_line(int argc, char **argv)
 
   handle_long_opts(argc, argv);
 
-  while ((c = getopt(argc, argv, ":hr:q:M:ftvC:V:E:F:T:m:Z:l:o:")) != -1) {
+  while ((c = getopt(argc, argv, ":hr:q:M:ftS:vC:V:E:F:T:m:Z:l:o:")) != -1) {
     if (common_opts(c, optopt))
       continue;
 
@@ -241,6 +249,12 @@ void waterman_opts::process_command_line(int argc, char **argv)
       tester_defeat = true;
       break;
 
+    case 'S':
+      if (strlen(optarg) > 1 || !strchr("hc", *optarg))
+        error("stream mode is '" + string(optarg) + "' must be h or c", c);
+      stream = *optarg;
+      break;
+
     case 'v':
       verbose = true;
       break;
@@ -399,6 +413,17 @@ void waterman_opts::process_command_line(int argc, char **argv)
     fill = false;
   }
 
+  if (stream) {
+    if (method != 1)
+      error("streaming can only be used with the sphere-ray method", 'S');
+    if (stream == 'h' && !(convex_hull && !add_hull))
+      error("streaming the convex hull can only be used with -C c", 'S');
+    if (stream == 'c' && fill)
+      error("streaming coordinates cannot be used with -f", 'S');
+    if (stream == 'c' && get_off_bin_output())
+      error("streaming coordinates cannot be used with --binary", 'S');
+  }
+
   if (tester_defeat) {
     if (method == 1)
       warning("computational error testing has been disabled!");
@@ -610,6 +635,110 @@ void refine_z_vals(long &z_near, long &z_far, const long x, const long y,
 // Separate function to contain protability problems with abs(long)
 long long_abs(long val) { return std::abs((long)val); }
 
+// find the surface points on the rays of a row, and count the computational
+// errors corrected and the false misses
+void sphere_ray_row(vector<Vec3d> &verts, long &errors, long &misses,
+                    const long y, const waterman_opts &opts,
+                    const bool cent_z_int, const vector<long> &i_center,
+                    const long long i_R2)
+{
+  long rad_left_x = (long)ceil(opts.center[0] - opts.radius);
+  long rad_right_x = (long)floor(opts.center[0] + opts.radius);
+
+  long z_near = 0;
+  long z_far = 0;
+
+  for (long x = rad_left_x; x <= rad_right_x; x++) {
+    // faster miss determination, but using for false miss detection
+    bool miss = true;
+    long long xy_contribution = ((long long)x * opts.scale - i_center[0]) *
+                                    (x * opts.scale - i_center[0]) +
+                                ((long long)y * opts.scale - i_center[1]) *
+                                    (y * opts.scale - i_center[1]);
+    if (inside_exact(i_center[2], i_center[2], xy_contribution, i_R2))
+      miss = false;
+    // continue;
+
+    if (!sphere_ray_z_intersect_points(
+            z_near, z_far, x, y, opts.origin_based, opts.center[0],
+            opts.center[1], opts.center[2], opts.R_squared, opts.eps)) {
+      // fprintf(stderr,"Ray missed the Sphere\n");
+      if (!miss) {
+        // if (verbose)
+        //   fprintf(stderr,"error: at x = %ld, y = %ld, a false miss
+        //   happened\n",x,y);
+        misses++;
+      }
+      continue;
+    }
+
+    // ray tangent points are never on integer when z of center is not on
+    // integer value
+    // NEEDS MORE TESTING
+    if (!cent_z_int && z_near == z_far)
+      continue;
+
+    if (opts.lattice_type !=
+        0) { // lattice type is not equal to SC (type = 0)
+      // if z_near is not on the lattice then find if a point 1 layer deeper
+      // is on the lattice
+      if (!valid_point(opts.lattice_type, long_abs(x), long_abs(y),
+                       long_abs(z_near))) {
+        // if it is a tangent point, there is no valid deeper coordinate. It
+        // was on "zero" already.
+        // if bcc and z_near-1 is invalid then there is no valid z point
+        // (z_far+1 will be invalid as well)
+        if (z_near == z_far ||
+            (opts.lattice_type == 2 &&
+             !valid_point(opts.lattice_type, long_abs(x), long_abs(y),
+                          long_abs(z_near - 1))))
+          continue;
+        else
+          z_near--;
+      }
+      // if still in the loop, z_far is only advanced if on invalid point
+      if (!valid_point(opts.lattice_type, long_abs(x), long_abs(y),
+                       long_abs(z_far)))
+        z_far++;
+    }
+
+    // uncommenting next 2 lines forces errors
+    // z_near += 5;
+    // z_far += 5;
+    if (!opts.tester_defeat && opts.scale) {
+      long z_near2 = z_near;
+      long z_far2 = z_far;
+      refine_z_vals(z_near2, z_far2, x, y, opts.lattice_type, opts.scale,
+                    i_center, i_R2);
+
+      if (z_near2 != z_near) {
+        errors++;
+        // if (verbose)
+        //   fprintf(stderr, "(%ld, %ld) z_near %ld -> %s\n", x, y, z_near,
+        //          (z_near2!=LONG_MAX) ? itostr(z_near2).c_str() :
+        //          "invalid");
+        z_near = z_near2;
+      }
+
+      if (z_far2 != z_far) {
+        errors++;
+        // if (verbose)
+        //   fprintf(stderr, "(%ld, %ld) z_far %ld -> %s\n", x, y, z_far,
+        //          (z_far2!=LONG_MAX) ? itostr(z_far2).c_str() :
+        //          "invalid");
+        z_far = z_far2;
+      }
+    }
+
+    // don't write invalid points
+    if (z_near != std::numeric_limits<long>::max())
+      verts.push_back(Vec3d(x, y, z_near));
+    if (z_far != std::numeric_limits<long>::max() &&
+        z_near != z_far) // don't rewrite tangent point
+      verts.push_back(Vec3d(x, y, z_far));
+  }
+}
+
 void sphere_ray_waterman(Geometry &geom, const waterman_opts &opts)
 {
   vector<Vec3d> &verts = geom.raw_verts();
@@ -634,104 +763,78 @@ void sphere_ray_waterman(Geometry &geom, const waterman_opts &opts)
   long long i_R2 = (long long)floor(
       opts.radius * opts.radius * opts.scale * opts.scale + 0.5);
 
-  long z_near = 0;
-  long z_far = 0;
-
   long total_errors = 0;
   long total_misses = 0;
 
-  for (long y = rad_bottom_y; y <= rad_top_y; y++) {
-    for (long x = rad_left_x; x <= rad_right_x; x++) {
-      // faster miss determination, but using for false miss detection
-      bool miss = true;
-      long long xy_contribution = ((long long)x * opts.scale - i_center[0]) *
-                                      (x * opts.scale - i_center[0]) +
-                                  ((long long)y * opts.scale - i_center[1]) *
-                                      (y * opts.scale - i_center[1]);
-      if (inside_exact(i_center[2], i_center[2], xy_contribution, i_R2))
-        miss = false;
-      // continue;
-
-      if (!sphere_ray_z_intersect_points(
-              z_near, z_far, x, y, opts.origin_based, opts.center[0],
-              opts.center[1], opts.center[2], opts.R_squared, opts.eps)) {
-        // fprintf(stderr,"Ray missed the Sphere\n");
-        if (!miss) {
-          // if (verbose)
-          //   fprintf(stderr,"error: at x = %ld, y = %ld, a false miss
-          //   happened\n",x,y);
-          total_misses++;
-        }
-        continue;
-      }
-
-      // ray tangent points are never on integer when z of center is not on
-      // integer value
-      // NEEDS MORE TESTING
-      if (!cent_z_int && z_near == z_far)
-        continue;
-
-      if (opts.lattice_type !=
-          0) { // lattice type is not equal to SC (type = 0)
-        // if z_near is not on the lattice then find if a point 1 layer deeper
-        // is on the lattice
-        if (!valid_point(opts.lattice_type, long_abs(x), long_abs(y),
-                         long_abs(z_near))) {
-          // if it is a tangent point, there is no valid deeper coordinate. It
-          // was on "zero" already.
-          // if bcc and z_near-1 is invalid then there is no valid z point
-          // (z_far+1 will be invalid as well)
-          if (z_near == z_far ||
-              (opts.lattice_type == 2 &&
-               !valid_point(opts.lattice_type, long_abs(x), long_abs(y),
-                            long_abs(z_near - 1))))
-            continue;
-          else
-            z_near--;
-        }
-        // if still in the loop, z_far is only advanced if on invalid point
-        if (!valid_point(opts.lattice_type, long_abs(x), long_abs(y),
-                         long_abs(z_far)))
-          z_far++;
-      }
+  FILE *crds_file = nullptr;
+  if (opts.stream == 'c') {
+    crds_file = stdout; // write to stdout by default
+    if (opts.ofile != "") {
+      crds_file = fopen(opts.ofile.c_str(), "w");
+      if (crds_file == nullptr)
+        opts.error("could not open output file \'" + opts.ofile + "\'");
+    }
+  }
 
-      // uncommenting next 2 lines forces errors
-      // z_near += 5;
-      // z_far += 5;
-      if (!opts.tester_defeat && opts.scale) {
-        long z_near2 = z_near;
-        long z_far2 = z_far;
-        refine_z_vals(z_near2, z_far2, x, y, opts.lattice_type, opts.scale,
-                      i_center, i_R2);
+  // the rows are processed in bands, all at once unless streaming. The
+  // rows of a band are interleaved between the threads, to share out the
+  // longer middle rows, and their points are added in row order
+  const long stream_band_points = 1 << 20;
+  const long row_len = std::max(rad_right_x - rad_left_x + 1, 1L);
+  const long band_rows = (opts.stream)
+                             ? std::max(stream_band_points / row_len, 1L)
+                             : rad_top_y - rad_bottom_y + 1;
+  for (long band_y = rad_bottom_y; band_y <= rad_top_y; band_y += band_rows) {
+    const int num_rows = (int)std::min(band_rows, rad_top_y - band_y + 1);
+    vector<vector<Vec3d>> row_verts(num_rows);
+    const int num_blks = parallel_blocks(num_rows, 0, 1); // costly rows
+    vector<long> blk_errors(num_blks, 0);
+    vector<long> blk_misses(num_blks, 0);
+    parallel_for_strided(
+        num_rows,
+        [&](int r, int blk) {
+          sphere_ray_row(row_verts[r], blk_errors[blk], blk_misses[blk],
+                         band_y + r, opts, cent_z_int, i_center, i_R2);
+        },
+        0, 1);
+
+    for (int blk = 0; blk < num_blks; blk++) {
+      total_errors += blk_errors[blk];
+      total_misses += blk_misses[blk];
+    }
 
-        if (z_near2 != z_near) {
-          total_errors++;
-          // if (verbose)
-          //   fprintf(stderr, "(%ld, %ld) z_near %ld -> %s\n", x, y, z_near,
-          //          (z_near2!=LONG_MAX) ? itostr(z_near2).c_str() :
-          //          "invalid");
-          z_near = z_near2;
-        }
+    if (crds_file) {
+      Geometry band;
+      for (auto &row : row_verts)
+        band.raw_verts().insert(band.raw_verts().end(), row.begin(),
+                                row.end());
+      band.write_crds(crds_file);
+      continue;
+    }
 
-        if (z_far2 != z_far) {
-          total_errors++;
-          // if (verbose)
-          //   fprintf(stderr, "(%ld, %ld) z_far %ld -> %s\n", x, y, z_far,
-          //          (z_far2!=LONG_MAX) ? itostr(z_far2).c_str() :
-          //          "invalid");
-          z_far = z_far2;
-        }
-      }
+    for (auto &row : row_verts) {
+      verts.insert(verts.end(), row.begin(), row.end());
+      vector<Vec3d>().swap(row);
+    }
 
-      // don't write invalid points
-      if (z_near != std::numeric_limits<long>::max())
-        verts.push_back(Vec3d(x, y, z_near));
-      if (z_far != std::numeric_limits<long>::max() &&
-          z_near != z_far) // don't rewrite tangent point
-        verts.push_back(Vec3d(x, y, z_far));
+    // only the convex hull vertices can be on the final hull
+    if (opts.stream == 'h' && band_y + band_rows <= rad_top_y) {
+      Geometry hull;
+      hull.raw_verts() = verts;
+      int dim;
+      if (!hull.set_hull("", &dim).is_error() && dim == 3)
+        verts = hull.verts();
     }
   }
 
+  if (crds_file) {
+    bool write_ok = (fflush(crds_file) == 0 && !ferror(crds_file));
+    if (crds_file != stdout)
+      write_ok = (fclose(crds_file) == 0) && write_ok;
+    if (!write_ok)
+      opts.error("could not write all the coordinates to the output");
+  }
+
   if (opts.verbose && !opts.tester_defeat)
     opts.message(msg_str("Total computational errors found and corrected: %ld",
                          total_errors),
@@ -893,6 +996,13 @@ int main(int argc, char *argv[])
   else
     z_guess_waterman(geom, opts);
 
+  // the points were written as they were found
+  if (opts.stream == 'c') {
+    if (opts.verbose)
+      fprintf(stderr, "done!\n");
+    return 0;
+  }
+
   // interior filling
   Geometry fill_verts;
   if (opts.fill) {
@@ -151,11 +151,15 @@ bool k_4_test(int x, int y, int z) //  dist2 = 2
 void add_struts(Geometry &geom, int len2)
 {
   const vector<Vec3d> &verts = geom.verts();
-  for (unsigned int i = 0; i < verts.size(); i++)
-    for (unsigned int j = i; j < verts.size(); j++) {
-      if (fabs((verts[i] - verts[j]).len2() - len2) < anti::epsilon)
+  // only vertices within the strut length are tested
+  PointIndex vert_index(verts, sqrt(len2 + anti::epsilon));
+  vector<int> strut_ends;
+  for (unsigned int i = 0; i < verts.size(); i++) {
+    vert_index.find_in_shell(verts[i], len2, anti::epsilon, strut_ends);
+    for (int j : strut_ends)
+      if (j >= (int)i)
         geom.add_edge(make_edge(i, j));
-    }
+  }
 }
 
 typedef bool (*COORD_TEST_F)(int, int, int);
@@ -341,7 +341,7 @@ void truncate_faces(Geometry &orig, double trunc_len)
     else
       idx02 = mi->second;
 
-    orig.faces(i) = {face[0], face[1], idx12, idx02};
+    orig.faces_mut(i) = {face[0], face[1], idx12, idx02};
   }
   orig.del(VERTS, orig.get_info().get_free_verts()); // delete F vertices
 }
@@ -308,14 +308,14 @@ void make_twist(Geometry &tw_geom, const Geometry &geom, const Symmetry &sym,
     auto col = tw_geom.colors(FACES).get(i);
     int unit_fsz = 4;
     if (method == 1) {
-      tw_geom.faces(i) = vector<int>(face.begin(), face.begin() + unit_fsz);
+      tw_geom.faces_mut(i) = vector<int>(face.begin(), face.begin() + unit_fsz);
     }
     else if (method == 2) {
-      tw_geom.faces(i) = vector<int>(face.begin(), face.begin() + unit_fsz);
+      tw_geom.faces_mut(i) = vector<int>(face.begin(), face.begin() + unit_fsz);
       tw_geom.add_face(vector<int>(face.begin() + unit_fsz, face.end()), col);
     }
     else if (method == 3) {
-      tw_geom.faces(i) = vector<int>(face.begin(), face.begin() + unit_fsz);
+      tw_geom.faces_mut(i) = vector<int>(face.begin(), face.begin() + unit_fsz);
       tw_geom.add_face({face[5], face[6], face[7], face[8]}, col);
       tw_geom.add_face({face[4], face[3], face[8], face[9]}, col);
     }
@@ -328,7 +328,8 @@ void make_twist(Geometry &tw_geom, const Geometry &geom, const Symmetry &sym,
             (tw_geom.verts(squ[j]) + tw_geom.verts(squ[(j + 1) % 4]) + cent) /
             3);
 
-      tw_geom.faces(i) = vector<int>({face[0], face[1], v_sz + 0, v_sz + 1});
+      tw_geom.faces_mut(i) =
+          vector<int>({face[0], face[1], v_sz + 0, v_sz + 1});
       tw_geom.add_face({face[3], face[2], v_sz + 1, v_sz + 2}, col);
       tw_geom.add_face({face[4], face[5], v_sz + 2, v_sz + 3}, col);
       tw_geom.add_face({face[7], face[6], v_sz + 3, v_sz + 0}, col);
@@ -336,7 +337,7 @@ void make_twist(Geometry &tw_geom, const Geometry &geom, const Symmetry &sym,
   }
 
   for (unsigned int i = 0; i < tw_geom.faces().size(); i++) {
-    auto &face = tw_geom.faces(i);
+    auto &face = tw_geom.faces_mut(i);
     std::rotate(face.begin(), face.begin() + 3, face.end());
   }
 }
@@ -195,14 +195,14 @@ int add_spidron_unit(Geometry &spid, double ang, double ang2, Vec3d &cent,
   spid.add_vert(Q);
   int f = spid.add_face(vector<int>());
   spid.colors(FACES).set(f, col);
-  spid.faces(f).push_back(v0idx);
-  spid.faces(f).push_back(v0idx + 1);
-  spid.faces(f).push_back(v0idx + 2);
+  spid.faces_mut(f).push_back(v0idx);
+  spid.faces_mut(f).push_back(v0idx + 1);
+  spid.faces_mut(f).push_back(v0idx + 2);
   f = spid.add_face(vector<int>());
   spid.colors(FACES).set(f, col);
-  spid.faces(f).push_back(v0idx + 1);
-  spid.faces(f).push_back(v0idx + 3);
-  spid.faces(f).push_back(v0idx + 2);
+  spid.faces_mut(f).push_back(v0idx + 1);
+  spid.faces_mut(f).push_back(v0idx + 3);
+  spid.faces_mut(f).push_back(v0idx + 2);
   cent += norm * delta_y;
   return true;
 }
@@ -255,14 +255,14 @@ int add_spidron_unit2(Geometry &spid, double ang, double ang2, Vec3d &cent,
   spid.add_vert(Q);
   int f = spid.add_face(vector<int>());
   spid.colors(FACES).set(f, col);
-  spid.faces(f).push_back(v0idx);
-  spid.faces(f).push_back(v0idx + 1);
-  spid.faces(f).push_back(v0idx + 2);
+  spid.faces_mut(f).push_back(v0idx);
+  spid.faces_mut(f).push_back(v0idx + 1);
+  spid.faces_mut(f).push_back(v0idx + 2);
   f = spid.add_face(vector<int>());
   spid.colors(FACES).set(f, col);
-  spid.faces(f).push_back(v0idx + 1);
-  spid.faces(f).push_back(v0idx + 3);
-  spid.faces(f).push_back(v0idx + 2);
+  spid.faces_mut(f).push_back(v0idx + 1);
+  spid.faces_mut(f).push_back(v0idx + 3);
+  spid.faces_mut(f).push_back(v0idx + 2);
 
   Trans3d trans = Trans3d::translate(cent) * Trans3d::rotate(norm, theta * 4) *
                   Trans3d::translate(-cent);